@@ -0,0 +1,71 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_BLAKE3_HPP_
+#define ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_BLAKE3_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rosbag2_storage_default_plugins/visibility_control.hpp"
+
+namespace rosbag2_storage_plugins
+{
+
+// BLAKE3 in plain and keyed hash mode with a 32 byte output, following the
+// reference implementation. Input is split into 1 KiB chunks merged as a
+// binary tree, with a stack of O(log n) chaining values. Large inputs hash
+// eight chunks at a time when AVX2 is available.
+// Not thread safe; each thread should own its own hasher.
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC BbrBlake3Hasher
+{
+public:
+  enum
+  {
+    KEY_SIZE = 32,
+    OUT_SIZE = 32,
+    BLOCK_SIZE = 64,
+    CHUNK_SIZE = 1024
+  };
+
+  BbrBlake3Hasher();
+
+  void init();
+  void init_keyed(const unsigned char * key);
+  void update(const void * data, size_t length);
+  void finalize(unsigned char * out);
+
+private:
+  void reset_chunk(uint64_t chunk_counter);
+  void compress_block(uint32_t extra_flags);
+  void push_chunk(const uint32_t * chaining_value);
+
+  uint32_t key_[8];
+  uint32_t flags_;
+
+  // Current chunk.
+  uint32_t chunk_cv_[8];
+  uint64_t chunk_counter_;
+  unsigned char block_[BLOCK_SIZE];
+  size_t block_length_;
+  size_t blocks_compressed_;
+
+  // Chaining values of completed subtrees, at most one per tree level.
+  uint32_t cv_stack_[54][8];
+  size_t cv_stack_size_;
+};
+
+}  // namespace rosbag2_storage_plugins
+
+#endif  // ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_BLAKE3_HPP_
@@ -0,0 +1,118 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_CHECKPOINT_POLICY_HPP_
+#define ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_CHECKPOINT_POLICY_HPP_
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "rosbag2_storage_default_plugins/visibility_control.hpp"
+
+namespace rosbag2_storage_plugins
+{
+
+// Progress of one topic chain since its digest was last anchored.
+struct CheckpointState
+{
+  size_t messages;
+  size_t bytes;
+  std::chrono::steady_clock::time_point last_checkpoint;
+};
+
+// Decides which digests of a topic chain are published as checkpoints.
+// Every message is still chained and stored, so anchoring any digest
+// commits to all of its predecessors. The policy is evaluated on every
+// write to a topic and, when a period is set, by a timer for idle topics.
+// The last digest of each topic is always anchored when the topic is
+// removed or the storage is closed.
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC CheckpointPolicy
+{
+public:
+  virtual ~CheckpointPolicy() = default;
+
+  virtual bool should_checkpoint(
+    const CheckpointState & state,
+    std::chrono::steady_clock::time_point now) const = 0;
+};
+
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC EveryNthCheckpointPolicy
+  : public CheckpointPolicy
+{
+public:
+  explicit EveryNthCheckpointPolicy(size_t messages);
+
+  bool should_checkpoint(
+    const CheckpointState & state,
+    std::chrono::steady_clock::time_point now) const override;
+
+private:
+  size_t messages_;
+};
+
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC PeriodicCheckpointPolicy
+  : public CheckpointPolicy
+{
+public:
+  explicit PeriodicCheckpointPolicy(std::chrono::milliseconds period);
+
+  bool should_checkpoint(
+    const CheckpointState & state,
+    std::chrono::steady_clock::time_point now) const override;
+
+private:
+  std::chrono::milliseconds period_;
+};
+
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC SizeCheckpointPolicy
+  : public CheckpointPolicy
+{
+public:
+  explicit SizeCheckpointPolicy(size_t bytes);
+
+  bool should_checkpoint(
+    const CheckpointState & state,
+    std::chrono::steady_clock::time_point now) const override;
+
+private:
+  size_t bytes_;
+};
+
+// Checkpoints as soon as any of its policies does.
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC AnyCheckpointPolicy
+  : public CheckpointPolicy
+{
+public:
+  void add(std::unique_ptr<CheckpointPolicy> policy);
+
+  bool should_checkpoint(
+    const CheckpointState & state,
+    std::chrono::steady_clock::time_point now) const override;
+
+private:
+  std::vector<std::unique_ptr<CheckpointPolicy>> policies_;
+};
+
+// Combines the enabled triggers; a zero value disables that trigger. With
+// every trigger disabled only the final digest of each topic is anchored.
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+std::unique_ptr<CheckpointPolicy> make_checkpoint_policy(
+  size_t every_n_messages,
+  std::chrono::milliseconds period,
+  size_t bytes);
+
+}  // namespace rosbag2_storage_plugins
+
+#endif  // ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_CHECKPOINT_POLICY_HPP_
@@ -15,9 +15,16 @@
 #ifndef ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_HELPER_HPP_
 #define ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_HELPER_HPP_
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "rosbag2_storage_default_plugins/visibility_control.hpp"
 #include "rosbag2_storage/serialized_bag_message.hpp"
 #include "rosbag2_storage/topic_metadata.hpp"
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_blake3.hpp"
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_sha256.hpp"
 
 #include "Poco/Crypto/DigestEngine.h"
 
@@ -25,12 +32,109 @@ namespace rosbag2_storage_plugins
 {
 
 const size_t NONCE_SIZE = 32;
+const size_t DIGEST_SIZE = 32;
 const std::string DIGEST_ENGINE_NAME = "SHA256";
 
+// Keyed function chaining the message digests of a topic. Recorded per topic
+// in the bbr_digest_algorithm column; bags without it use HMAC-SHA256.
+// Topic digests, segment keys and links always use HMAC-SHA256.
+const uint8_t DIGEST_ALGORITHM_HMAC_SHA256 = 0;
+const uint8_t DIGEST_ALGORITHM_BLAKE3_KEYED = 1;
+
+// Maps the digest_algorithm parameter, "hmac_sha256" or "blake3", to its
+// constant. Throws std::invalid_argument for any other name.
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+uint8_t parseDigestAlgorithm(const std::string & name);
+
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+const char * getDigestAlgorithmName(uint8_t digest_algorithm);
+
+// Encoding of the message header fed into each message digest. Recorded per
+// topic in the bbr_format column; bags without it use the protobuf encoding.
+const uint8_t MESSAGE_FORMAT_PROTOBUF = 0;
+const uint8_t MESSAGE_FORMAT_CANONICAL = 1;
+
+// Canonical layout: version byte, flags byte, little endian int64 stamp and,
+// when the sequence flag is set, a little endian uint64 sequence number.
+const uint8_t MESSAGE_HEADER_HAS_SEQUENCE = 0x01;
+// Set on headers that derive segment keys and links rather than digest a
+// message, so the two can never collide.
+const uint8_t MESSAGE_HEADER_SEGMENT = 0x02;
+const size_t MESSAGE_HEADER_MAX_SIZE = 18;
+
+struct MessageHeader
+{
+  uint8_t data[MESSAGE_HEADER_MAX_SIZE];
+  size_t size;
+};
+
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+MessageHeader encodeMessageHeader(
+  rcutils_time_point_value_t time_stamp,
+  bool has_sequence = false,
+  uint64_t sequence = 0);
+
+// Known-answer test of a SHA-256 backend: RFC 4231 test case 2, then
+// HMACs around the block and padding boundaries compared with
+// Poco::HMACEngine, all hashed as one batch.
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+bool selfTestSha256Backend(Sha256Backend backend);
+
+// Known-answer test of BbrBlake3Hasher against the published BLAKE3 test
+// vectors, covering a single chunk, a chunk tree, the AVX2 lanes and keyed
+// mode.
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+bool selfTestBlake3();
+
+// One message of an independent chain, hashed together with others by
+// BbrHelper::computeMessageDigests. The digest is filled in.
+struct MessageDigestJob
+{
+  const rcutils_uint8_array_t * nonce;
+  rcutils_time_point_value_t time_stamp;
+  const rcutils_uint8_array_t * data;
+  std::shared_ptr<rcutils_uint8_array_t> digest;
+};
+
+// Reusable HMAC-SHA256 context, re-keyed for every chained digest instead of
+// building a new Poco::HMACEngine per call. It hashes with the self-tested
+// SHA-256 backend and owns its digest buffer, so after construction neither
+// init() nor digest() allocates.
+// Not thread safe; each thread should own its own context.
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC BbrHmacContext
+{
+public:
+  enum
+  {
+    BLOCK_SIZE = 64
+  };
+
+  BbrHmacContext();
+
+  void init(const unsigned char * key, size_t length);
+  void update(const void * data, size_t length);
+  // Valid until the next call to digest().
+  const Poco::DigestEngine::Digest & digest();
+
+private:
+  BbrSha256Hasher hasher_;
+  unsigned char opad_[BLOCK_SIZE];
+  Poco::DigestEngine::Digest digest_;
+};
+
 class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC BbrHelper
 {
 public:
-  BbrHelper();
+  explicit BbrHelper(
+    uint8_t message_format = MESSAGE_FORMAT_CANONICAL,
+    uint8_t digest_algorithm = DIGEST_ALGORITHM_HMAC_SHA256);
+
+  void setMessageFormat(uint8_t message_format);
+  uint8_t getMessageFormat() const;
+
+  // Throws std::invalid_argument for an unknown algorithm.
+  void setDigestAlgorithm(uint8_t digest_algorithm);
+  uint8_t getDigestAlgorithm() const;
 
   std::shared_ptr<rcutils_uint8_array_t> createNonce();
 
@@ -46,15 +150,63 @@ public:
     std::shared_ptr<rcutils_uint8_array_t> nonce,
     std::shared_ptr<const rosbag2_storage::SerializedBagMessage> message);
 
+  // Buffers are fed straight into the digest engine without being copied.
+  std::shared_ptr<rcutils_uint8_array_t> computeMessageDigest(
+    const rcutils_uint8_array_t & nonce,
+    rcutils_time_point_value_t time_stamp,
+    const rcutils_uint8_array_t & data);
+
+  // Segmented chains restart every K messages from a key derived from the
+  // topic nonce and the segment index, so segments verify independently.
+  std::shared_ptr<rcutils_uint8_array_t> computeSegmentKey(
+    const rcutils_uint8_array_t & nonce,
+    uint64_t segment_index);
+
+  // Links a closed segment's last digest into the chain of segment roots.
+  std::shared_ptr<rcutils_uint8_array_t> computeSegmentLink(
+    const rcutils_uint8_array_t & previous_link,
+    uint64_t segment_index,
+    const rcutils_uint8_array_t & root);
+
+  // Same digests as computeMessageDigest, but with HMAC-SHA256 the jobs go
+  // to the SHA-256 backend as one batch so small messages of different topics
+  // share lanes. No job may use another job's digest as its nonce.
+  void computeMessageDigests(std::vector<MessageDigestJob> & jobs);
+
+  // Fastest backend that passed its self-test, chosen on first use.
+  static Sha256Backend getSha256Backend();
+
+  bool verifyMessageDigest(
+    const rcutils_uint8_array_t & nonce,
+    rcutils_time_point_value_t time_stamp,
+    const rcutils_uint8_array_t & data,
+    const rcutils_uint8_array_t & digest);
+
 private:
-  Poco::DigestEngine::Digest computeHMAC(
-    std::string passphrase,
-    std::istringstream & istr);
-
-  Poco::DigestEngine::Digest computeHMAC(
-    std::string passphrase,
-    std::istringstream & istr1,
-    std::istringstream & istr2);
+  const Poco::DigestEngine::Digest & computeHMAC(
+    const rcutils_uint8_array_t & passphrase,
+    const std::string & info);
+
+  const Poco::DigestEngine::Digest & computeHMAC(
+    const rcutils_uint8_array_t & passphrase,
+    const void * header,
+    size_t header_size,
+    const rcutils_uint8_array_t & data);
+
+  // Keyed BLAKE3 over header || data. Nonces that are not 32 bytes are
+  // hashed into a key first.
+  void computeKeyedBlake3(
+    const rcutils_uint8_array_t & nonce,
+    const void * header,
+    size_t header_size,
+    const rcutils_uint8_array_t & data,
+    unsigned char * digest);
+
+  uint8_t message_format_;
+  uint8_t digest_algorithm_;
+  std::string message_info_str_;
+  BbrHmacContext hmac_;
+  BbrBlake3Hasher blake3_;
 };
 
 }  // namespace rosbag2_storage_plugins
@@ -0,0 +1,77 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_MERKLE_HPP_
+#define ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_MERKLE_HPP_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "rosbag2_storage_default_plugins/visibility_control.hpp"
+
+#include "Poco/Crypto/DigestEngine.h"
+
+namespace rosbag2_storage_plugins
+{
+
+// Streaming Merkle tree over message digests, shaped as in RFC 6962: leaves
+// are hashed as SHA256(0x00 || digest) and nodes as SHA256(0x01 || l || r),
+// and a tree of n leaves splits at the largest power of two below n. Only
+// the O(log n) perfect subtree peaks are kept while appending.
+// Not thread safe; each thread should own its own accumulator.
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC BbrMerkleAccumulator
+{
+public:
+  using Digest = Poco::DigestEngine::Digest;
+
+  struct ProofStep
+  {
+    Digest sibling;
+    // Whether the sibling is hashed in on the left.
+    bool left;
+  };
+
+  BbrMerkleAccumulator();
+
+  void append(const unsigned char * digest, size_t length);
+  size_t size() const;
+  void reset();
+
+  // Root over all leaves appended since the last reset.
+  Digest root();
+
+  // Audit path from leaf index to the root of the given leaves, bottom up.
+  // The path has O(log n) steps, but its sibling subtrees are rehashed from
+  // the leaves, so building it costs O(n) hashes.
+  std::vector<ProofStep> prove(const std::vector<Digest> & leaves, size_t index);
+  bool verify(const Digest & leaf, const std::vector<ProofStep> & proof, const Digest & root);
+
+private:
+  Digest hash_leaf(const unsigned char * digest, size_t length);
+  Digest hash_node(const Digest & left, const Digest & right);
+  Digest subtree_root(const std::vector<Digest> & leaves, size_t begin, size_t end);
+  void prove(
+    const std::vector<Digest> & leaves, size_t begin, size_t end, size_t index,
+    std::vector<ProofStep> & proof);
+
+  Poco::Crypto::DigestEngine engine_;
+  // Perfect subtrees from left to right with their leaf counts.
+  std::vector<std::pair<size_t, Digest>> peaks_;
+  size_t size_;
+};
+
+}  // namespace rosbag2_storage_plugins
+
+#endif  // ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_MERKLE_HPP_
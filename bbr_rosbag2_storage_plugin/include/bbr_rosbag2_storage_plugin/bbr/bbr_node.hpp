@@ -17,7 +17,15 @@
 
 #include "rosbag2_storage_default_plugins/visibility_control.hpp"
 
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "bbr_msgs/msg/checkpoint.hpp"
 #include "bbr_msgs/msg/checkpoint_array.hpp"
@@ -40,9 +48,19 @@ class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC BbrNode
   : public rclcpp::Node
 {
 public:
+  enum class RecordStatus
+  {
+    UNKNOWN,
+    PENDING,
+    CREATED,
+    FAILED
+  };
+
   explicit BbrNode(const std::string & node_name);
-  ~BbrNode() override = default;
+  ~BbrNode() override;
 
+  // Sends the record to the bridge and returns immediately; confirmation,
+  // timeouts and retries are handled on the spin thread.
   void create_record(
     std::shared_ptr<rcutils_uint8_array_t> nonce,
     const rosbag2_storage::TopicMetadata & topic);
@@ -50,12 +68,83 @@ public:
   void publish_checkpoint(
     std::shared_ptr<rcutils_uint8_array_t> nonce,
     std::shared_ptr<rcutils_uint8_array_t> hash,
-    std::shared_ptr<const rosbag2_storage::SerializedBagMessage> message);
+    rcutils_time_point_value_t stamp);
+
+  // Publishes every pending checkpoint batch regardless of its limits.
+  void flush_checkpoints();
+
+  RecordStatus get_record_status(const std::string & topic_name) const;
 
 private:
+  struct PendingRecord
+  {
+    bbr_msgs::msg::Record record;
+    RecordStatus status;
+    size_t attempts;
+    bool queued;
+    std::chrono::steady_clock::time_point sent;
+  };
+
+  struct RecordRequest
+  {
+    // Topic name and attempt number of every record in the request.
+    using Attempts = std::vector<std::pair<std::string, size_t>>;
+    Attempts attempts;
+    bbr_msgs::srv::CreateRecords::Request::SharedPtr request;
+  };
+
+  void queue_record(PendingRecord & pending);
+  bool prepare_record_request(RecordRequest & record_request);
+  void send_record_request(const RecordRequest & record_request);
+  void handle_record_response(
+    const RecordRequest::Attempts & attempts,
+    rclcpp::Client<bbr_msgs::srv::CreateRecords>::SharedFuture result_future);
+  void retry_record(PendingRecord & pending, const char * reason);
+  void check_records();
+  bool discover_service(std::chrono::steady_clock::time_point now);
+
+  struct CheckpointBatch
+  {
+    bbr_msgs::msg::CheckpointArray checkpoint_array;
+    size_t bytes;
+    std::chrono::steady_clock::time_point started;
+  };
+
+  void flush_expired_checkpoints();
+  void run_executor();
+
   rclcpp::TimerBase::SharedPtr timer_;
   rclcpp::Publisher<bbr_msgs::msg::CheckpointArray>::SharedPtr checkpoints_publisher_;
   rclcpp::Client<bbr_msgs::srv::CreateRecords>::SharedPtr records_client_;
+
+  // Checkpoints are accumulated per record uid and published as one
+  // CheckpointArray once a batch reaches its count, size or age limit.
+  size_t checkpoint_batch_size_;
+  size_t checkpoint_batch_bytes_;
+  std::chrono::milliseconds checkpoint_linger_;
+  std::unordered_map<std::string, CheckpointBatch> checkpoint_batches_;
+  std::mutex checkpoints_mutex_;
+
+  // Records keyed by topic name, kept after confirmation for status queries.
+  std::chrono::milliseconds record_timeout_;
+  size_t record_max_attempts_;
+  std::chrono::milliseconds record_batch_window_;
+  size_t record_batch_size_;
+  std::unordered_map<std::string, PendingRecord> records_;
+  std::vector<std::string> queued_records_;
+  std::chrono::steady_clock::time_point queued_since_;
+  std::chrono::milliseconds service_timeout_;
+  std::chrono::steady_clock::time_point discovery_start_;
+  bool service_available_;
+  bool service_warned_;
+  mutable std::mutex records_mutex_;
+  rclcpp::TimerBase::SharedPtr records_timer_;
+
+  // The node is spun on its own thread so the linger timer and service
+  // responses are handled while rosbag2 keeps writing.
+  rclcpp::executors::SingleThreadedExecutor executor_;
+  std::atomic<bool> spinning_;
+  std::thread spin_thread_;
 };
 
 }  // namespace rosbag2_storage_plugins
@@ -0,0 +1,82 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_READ_CURSOR_HPP_
+#define ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_READ_CURSOR_HPP_
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rcutils/time.h"
+#include "rcutils/types.h"
+#include "rosbag2_storage_default_plugins/visibility_control.hpp"
+
+namespace rosbag2_storage_plugins
+{
+
+// Streams the rows of a message query from a background thread. The thread
+// owns a separate read-only connection and fills blocks of rows into a
+// double buffer, so stepping SQLite overlaps with the consumer.
+// The query must select data, timestamp and topic_id, in that order.
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC BbrReadCursor
+{
+public:
+  struct Row
+  {
+    std::shared_ptr<rcutils_uint8_array_t> data;
+    rcutils_time_point_value_t timestamp;
+    int topic_id;
+  };
+
+  BbrReadCursor(
+    const std::string & database_path,
+    const std::string & query,
+    size_t block_size = 1024);
+  ~BbrReadCursor();
+
+  BbrReadCursor(const BbrReadCursor &) = delete;
+  BbrReadCursor & operator=(const BbrReadCursor &) = delete;
+
+  bool has_next();
+  Row & next();
+
+private:
+  void run();
+  bool publish_block(std::vector<Row> & block);
+
+  std::string database_path_;
+  std::string query_;
+  size_t block_size_;
+
+  std::vector<Row> front_;
+  size_t front_index_;
+  std::vector<Row> back_;
+  bool back_ready_;
+  bool finished_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable block_ready_;
+  std::condition_variable block_consumed_;
+  std::thread thread_;
+};
+
+}  // namespace rosbag2_storage_plugins
+
+#endif  // ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_READ_CURSOR_HPP_
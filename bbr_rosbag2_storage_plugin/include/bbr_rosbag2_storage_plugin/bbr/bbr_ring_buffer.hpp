@@ -0,0 +1,148 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_RING_BUFFER_HPP_
+#define ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_RING_BUFFER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace rosbag2_storage_plugins
+{
+
+// Bounded lock-free queue after Dmitry Vyukov's array based design.
+// Any number of producers and consumers may call try_push/try_pop
+// concurrently; the writer uses it as MPSC, with producers popping only
+// to implement drop-oldest back-pressure.
+template<typename T>
+class BbrRingBuffer
+{
+public:
+  explicit BbrRingBuffer(size_t capacity)
+  : mask_(round_up(capacity) - 1),
+    buffer_(new Cell[mask_ + 1]),
+    enqueue_pos_(0),
+    dequeue_pos_(0)
+  {
+    for (size_t i = 0; i <= mask_; ++i) {
+      buffer_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BbrRingBuffer(const BbrRingBuffer &) = delete;
+  BbrRingBuffer & operator=(const BbrRingBuffer &) = delete;
+
+  bool try_push(T && value)
+  {
+    Cell * cell;
+    size_t pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+    for (;; ) {
+      cell = &buffer_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T & value)
+  {
+    Cell * cell;
+    size_t pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+    for (;; ) {
+      cell = &buffer_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->data);
+    cell->data = T();
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate while producers or consumers are active.
+  size_t size() const
+  {
+    size_t enqueued = enqueue_pos_.value.load(std::memory_order_relaxed);
+    size_t dequeued = dequeue_pos_.value.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+
+  bool empty() const
+  {
+    return size() == 0;
+  }
+
+  size_t capacity() const
+  {
+    return mask_ + 1;
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  static size_t round_up(size_t capacity)
+  {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  // Padding keeps the producer and consumer indices on separate cache lines.
+  struct PaddedIndex
+  {
+    explicit PaddedIndex(size_t initial)
+    : value(initial) {}
+
+    std::atomic<size_t> value;
+    char padding[64 - sizeof(std::atomic<size_t>)];
+  };
+
+  const size_t mask_;
+  std::unique_ptr<Cell[]> buffer_;
+  PaddedIndex enqueue_pos_;
+  PaddedIndex dequeue_pos_;
+};
+
+}  // namespace rosbag2_storage_plugins
+
+#endif  // ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_RING_BUFFER_HPP_
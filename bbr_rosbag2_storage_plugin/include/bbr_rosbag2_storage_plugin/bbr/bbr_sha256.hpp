@@ -0,0 +1,89 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_SHA256_HPP_
+#define ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_SHA256_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rosbag2_storage_default_plugins/visibility_control.hpp"
+
+namespace rosbag2_storage_plugins
+{
+
+const size_t SHA256_BLOCK_SIZE = 64;
+const size_t SHA256_DIGEST_SIZE = 32;
+
+// SCALAR is portable C++. SHA_NI hashes one stream at a time with the x86
+// SHA extensions. AVX2 hashes up to eight independent streams in lanes.
+enum class Sha256Backend
+{
+  SCALAR,
+  SHA_NI,
+  AVX2
+};
+
+// One HMAC-SHA256 over header || data, written to digest.
+struct HmacSha256Job
+{
+  const unsigned char * key;
+  size_t key_length;
+  const void * header;
+  size_t header_size;
+  const void * data;
+  size_t data_length;
+  unsigned char * digest;
+};
+
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+bool isSha256BackendSupported(Sha256Backend backend);
+
+// Fastest backend the CPU and OS support, in the order SHA_NI, AVX2, SCALAR.
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+Sha256Backend detectSha256Backend();
+
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+const char * getSha256BackendName(Sha256Backend backend);
+
+// Computes independent HMACs. The AVX2 backend hashes small jobs eight at a
+// time and falls back to one stream for large ones; the other backends go
+// job by job. The backend must be supported.
+ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC
+void computeHmacSha256(HmacSha256Job * jobs, size_t count, Sha256Backend backend);
+
+// Streaming SHA-256 of a single message. AVX2 has no single stream kernel,
+// so it hashes with the SHA extensions if present and scalar code otherwise.
+// The backend must be supported. Holds no heap memory, so init() is cheap.
+// Not thread safe; each thread should own its own hasher.
+class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC BbrSha256Hasher
+{
+public:
+  explicit BbrSha256Hasher(Sha256Backend backend = Sha256Backend::SCALAR);
+
+  void init();
+  void update(const void * data, size_t length);
+  void finalize(unsigned char * out);
+
+private:
+  void (* compress_)(uint32_t * state, const unsigned char * data, size_t blocks);
+  uint32_t state_[8];
+  unsigned char buffer_[SHA256_BLOCK_SIZE];
+  size_t buffered_;
+  uint64_t length_;
+};
+
+}  // namespace rosbag2_storage_plugins
+
+#endif  // ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_SHA256_HPP_
@@ -16,8 +16,15 @@
 #ifndef ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_STORAGE_HPP_
 #define ROSBAG2_STORAGE_DEFAULT_PLUGINS__BBR__BBR_STORAGE_HPP_
 
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -25,8 +32,12 @@
 #include "rosbag2_storage/storage_interfaces/read_write_interface.hpp"
 #include "rosbag2_storage/serialized_bag_message.hpp"
 #include "rosbag2_storage/topic_metadata.hpp"
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_checkpoint_policy.hpp"
 #include "bbr_rosbag2_storage_plugin/bbr/bbr_helper.hpp"
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_merkle.hpp"
 #include "bbr_rosbag2_storage_plugin/bbr/bbr_node.hpp"
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_read_cursor.hpp"
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_ring_buffer.hpp"
 #include "rosbag2_storage_default_plugins/sqlite/sqlite_wrapper.hpp"
 #include "rosbag2_storage_default_plugins/visibility_control.hpp"
 
@@ -46,7 +57,7 @@ class ROSBAG2_STORAGE_DEFAULT_PLUGINS_PUBLIC BbrStorage
 {
 public:
   BbrStorage();
-  ~BbrStorage() override = default;
+  ~BbrStorage() override;
 
   void open(
     const std::string & uri,
@@ -67,37 +78,191 @@ public:
 
   rosbag2_storage::BagMetadata get_metadata() override;
 
+  struct WriterStatistics
+  {
+    size_t queue_depth;
+    size_t max_queue_depth;
+    uint64_t dropped_messages;
+  };
+
+  WriterStatistics get_writer_statistics() const;
+
+  // Size of the database as last sampled plus the bytes inserted since. It is
+  // sampled on commit, on flush and after every 1 MiB or second of writes.
+  // Safe to call from any thread while recording.
+  uint64_t get_bag_size() const;
+
+  // Restricts playback to the given topics and the closed interval
+  // [start_time, end_time]. An empty topic list selects every topic.
+  struct ReadFilter
+  {
+    std::vector<std::string> topics;
+    rcutils_time_point_value_t start_time = 0;
+    rcutils_time_point_value_t end_time = INT64_MAX;
+  };
+
+  // Both restart playback from the first matching message.
+  void set_read_filter(const ReadFilter & filter);
+  void seek(rcutils_time_point_value_t timestamp);
+
+  struct InclusionProof
+  {
+    size_t leaf_index;
+    size_t leaf_count;
+    BbrMerkleAccumulator::Digest leaf;
+    BbrMerkleAccumulator::Digest root;
+    std::vector<BbrMerkleAccumulator::ProofStep> path;
+  };
+
+  // Proves that the message a topic recorded at time_stamp is covered by the
+  // Merkle root anchored for its checkpoint window. Only window roots are
+  // stored, so every call reads and rehashes all digests of the window:
+  // O(window) per proof, bounded by the checkpoint policy.
+  InclusionProof get_inclusion_proof(
+    const std::string & topic_name, rcutils_time_point_value_t time_stamp);
+
+  // Ledger confirmation state of the record created for a topic.
+  BbrNode::RecordStatus get_record_status(const std::string & topic_name) const;
+
 private:
+  enum class OverflowPolicy
+  {
+    BLOCK,
+    DROP_OLDEST,
+    DROP_NEWEST
+  };
+
+  // Per-topic totals, kept up to date on every write and persisted to the
+  // topic_summary table on close so metadata never scans messages.
+  struct TopicSummary
+  {
+    rosbag2_storage::TopicMetadata topic;
+    size_t message_count;
+    rcutils_time_point_value_t min_stamp;
+    rcutils_time_point_value_t max_stamp;
+    uint64_t bytes;
+  };
+
+  struct TopicInfo
+  {
+    int id;
+    std::shared_ptr<rcutils_uint8_array_t> digest;
+    std::shared_ptr<rcutils_uint8_array_t> nonce;
+    rcutils_time_point_value_t last_stamp;
+    CheckpointState checkpoint;
+    TopicSummary summary;
+    // Segmented chains: position in the current segment and the link over
+    // all closed segment roots. segment_size is 0 for a single chain.
+    size_t segment_size;
+    uint64_t segment_index;
+    size_t segment_messages;
+    rcutils_time_point_value_t segment_first_id;
+    rcutils_time_point_value_t segment_last_id;
+    std::shared_ptr<rcutils_uint8_array_t> segment_link;
+    // Merkle tree over the digests of the current checkpoint window, null
+    // unless checkpoint_merkle is set.
+    std::unique_ptr<BbrMerkleAccumulator> merkle;
+    uint64_t merkle_window;
+    rcutils_time_point_value_t merkle_first_id;
+    rcutils_time_point_value_t merkle_last_id;
+  };
+
   void initialize();
+  void apply_bulk_load_pragmas();
   void prepare_for_writing();
   void prepare_for_reading();
+  void write_message(
+    std::shared_ptr<const rosbag2_storage::SerializedBagMessage> message,
+    std::shared_ptr<rcutils_uint8_array_t> digest = nullptr);
+  void write_messages(
+    const std::vector<std::shared_ptr<const rosbag2_storage::SerializedBagMessage>> & messages);
+  void anchor_checkpoint(TopicInfo & topic_info, std::chrono::steady_clock::time_point now);
+  void anchor_unanchored_topics();
+  void close_segment(TopicInfo & topic_info);
+  void close_open_segments();
+  std::shared_ptr<rcutils_uint8_array_t> close_merkle_window(TopicInfo & topic_info);
+  void begin_transaction();
+  void commit_transaction();
+  void enqueue(std::shared_ptr<const rosbag2_storage::SerializedBagMessage> message);
+  void run_writer();
+  void stop_writer();
+  void run_checkpoint_timer();
+  void stop_checkpoint_timer();
+  void flush();
+  void create_indexes();
+  void write_topic_summaries();
+  void sample_database_size();
+  std::vector<TopicSummary> load_topic_summaries();
+  bool table_exists(const std::string & table_name);
+  std::string make_read_query() const;
   void fill_topics_and_types();
 
   std::unique_ptr<rosbag2_storage::BagMetadata> load_metadata(const std::string & uri);
   bool database_exists(const std::string & uri);
   bool is_read_only(const rosbag2_storage::storage_interfaces::IOFlag & io_flag) const;
 
-  using ReadQueryResult = SqliteStatementWrapper::QueryResult<
-    std::shared_ptr<rcutils_uint8_array_t>, rcutils_time_point_value_t, std::string>;
-
   std::shared_ptr<BbrNode> node_;
   std::shared_ptr<BbrHelper> helper_;
   std::shared_ptr<rcutils_uint8_array_t> nonce_;
 
   std::shared_ptr<SqliteWrapper> database_;
   std::string database_name_;
+  std::string database_path_;
   SqliteStatement write_statement_;
-  SqliteStatement read_statement_;
-  ReadQueryResult message_result_;
-  ReadQueryResult::Iterator current_message_row_;
-  struct TopicInfo
+  // Playback streams rows through a prefetching cursor and resolves
+  // topic ids against names loaded once from the topics table.
+  std::unique_ptr<BbrReadCursor> read_cursor_;
+  std::unordered_map<int, std::string> topic_names_;
+  ReadFilter read_filter_;
+  std::unordered_map<std::string, TopicInfo> topics_;
+  std::unique_ptr<CheckpointPolicy> checkpoint_policy_;
+  size_t chain_segment_size_;
+  bool checkpoint_merkle_;
+  std::vector<rosbag2_storage::TopicMetadata> all_topics_and_types_;
+
+  // With checkpoint_period_ms set, a timer thread anchors topics that stop
+  // receiving messages; it holds write_mutex_ while it touches topics_.
+  std::chrono::milliseconds checkpoint_period_;
+  std::thread checkpoint_thread_;
+  std::condition_variable checkpoint_timer_;
+  bool stop_checkpoint_timer_;
+
+  // Group commit: messages are inserted inside one transaction until either
+  // limit is reached. Checkpoints are held back until their rows are durable.
+  struct PendingCheckpoint
   {
-    int id;
-    std::shared_ptr<rcutils_uint8_array_t> digest;
     std::shared_ptr<rcutils_uint8_array_t> nonce;
+    std::shared_ptr<rcutils_uint8_array_t> digest;
+    rcutils_time_point_value_t stamp;
   };
-  std::unordered_map<std::string, TopicInfo> topics_;
-  std::vector<rosbag2_storage::TopicMetadata> all_topics_and_types_;
+  size_t group_commit_messages_;
+  std::chrono::milliseconds group_commit_period_;
+  bool in_transaction_;
+  size_t transaction_messages_;
+  std::chrono::steady_clock::time_point transaction_start_;
+  std::vector<PendingCheckpoint> pending_checkpoints_;
+  std::atomic<uint64_t> database_size_;
+  std::atomic<uint64_t> unsampled_bytes_;
+  std::chrono::steady_clock::time_point size_sampled_;
+
+  // Async mode: write() only enqueues, the writer thread hashes, inserts
+  // and checkpoints. write_mutex_ guards the database and topics_ between
+  // the writer thread, the checkpoint timer and the calling thread.
+  using MessageQueue =
+    BbrRingBuffer<std::shared_ptr<const rosbag2_storage::SerializedBagMessage>>;
+  bool async_write_;
+  OverflowPolicy overflow_policy_;
+  std::unique_ptr<MessageQueue> queue_;
+  std::thread writer_thread_;
+  std::mutex write_mutex_;
+  std::condition_variable data_available_;
+  std::condition_variable space_available_;
+  std::condition_variable queue_drained_;
+  std::atomic<bool> writer_sleeping_;
+  std::atomic<bool> stop_writer_;
+  std::atomic<size_t> max_queue_depth_;
+  std::atomic<uint64_t> dropped_messages_;
+  std::exception_ptr writer_error_;
 };
 
 }  // namespace rosbag2_storage_plugins
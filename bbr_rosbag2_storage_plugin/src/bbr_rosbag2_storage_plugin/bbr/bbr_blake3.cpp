@@ -0,0 +1,361 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_blake3.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_sha256.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define BBR_BLAKE3_X86 1
+# include <immintrin.h>
+#endif
+
+namespace rosbag2_storage_plugins
+{
+
+namespace
+{
+
+const uint32_t IV[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+const size_t MESSAGE_PERMUTATION[16] = {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8};
+
+const uint32_t CHUNK_START = 1 << 0;
+const uint32_t CHUNK_END = 1 << 1;
+const uint32_t PARENT = 1 << 2;
+const uint32_t ROOT = 1 << 3;
+const uint32_t KEYED_HASH = 1 << 4;
+
+inline uint32_t rotr(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t load_le32(const unsigned char * data)
+{
+  return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+         (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+inline void g(uint32_t * state, size_t a, size_t b, size_t c, size_t d, uint32_t x, uint32_t y)
+{
+  state[a] = state[a] + state[b] + x;
+  state[d] = rotr(state[d] ^ state[a], 16);
+  state[c] = state[c] + state[d];
+  state[b] = rotr(state[b] ^ state[c], 12);
+  state[a] = state[a] + state[b] + y;
+  state[d] = rotr(state[d] ^ state[a], 8);
+  state[c] = state[c] + state[d];
+  state[b] = rotr(state[b] ^ state[c], 7);
+}
+
+// Returns the first eight words of the compression output, which is all a
+// 32 byte hash ever needs.
+void compress(
+  const uint32_t * chaining_value, const uint32_t * block_words, uint64_t counter,
+  uint32_t block_length, uint32_t flags, uint32_t * out)
+{
+  uint32_t state[16] = {
+    chaining_value[0], chaining_value[1], chaining_value[2], chaining_value[3],
+    chaining_value[4], chaining_value[5], chaining_value[6], chaining_value[7],
+    IV[0], IV[1], IV[2], IV[3],
+    static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), block_length, flags
+  };
+  uint32_t m[16];
+  std::memcpy(m, block_words, sizeof(m));
+
+  for (int round = 0; round < 7; ++round) {
+    g(state, 0, 4, 8, 12, m[0], m[1]);
+    g(state, 1, 5, 9, 13, m[2], m[3]);
+    g(state, 2, 6, 10, 14, m[4], m[5]);
+    g(state, 3, 7, 11, 15, m[6], m[7]);
+    g(state, 0, 5, 10, 15, m[8], m[9]);
+    g(state, 1, 6, 11, 12, m[10], m[11]);
+    g(state, 2, 7, 8, 13, m[12], m[13]);
+    g(state, 3, 4, 9, 14, m[14], m[15]);
+
+    uint32_t permuted[16];
+    for (size_t i = 0; i < 16; ++i) {
+      permuted[i] = m[MESSAGE_PERMUTATION[i]];
+    }
+    std::memcpy(m, permuted, sizeof(m));
+  }
+
+  for (size_t i = 0; i < 8; ++i) {
+    out[i] = state[i] ^ state[i + 8];
+  }
+}
+
+void load_block(const unsigned char * block, uint32_t * words)
+{
+  for (size_t i = 0; i < 16; ++i) {
+    words[i] = load_le32(block + 4 * i);
+  }
+}
+
+void parent_cv(
+  const uint32_t * left, const uint32_t * right, const uint32_t * key, uint32_t flags,
+  uint32_t * out)
+{
+  uint32_t block_words[16];
+  std::memcpy(block_words, left, 8 * sizeof(uint32_t));
+  std::memcpy(block_words + 8, right, 8 * sizeof(uint32_t));
+  compress(key, block_words, 0, BbrBlake3Hasher::BLOCK_SIZE, flags | PARENT, out);
+}
+
+#ifdef BBR_BLAKE3_X86
+
+const size_t AVX2_CHUNKS = 8;
+
+__attribute__((target("avx2")))
+inline __m256i rotr_x8(__m256i x, int n)
+{
+  return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+__attribute__((target("avx2")))
+inline void g_x8(__m256i * v, size_t a, size_t b, size_t c, size_t d, __m256i x, __m256i y)
+{
+  v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), x);
+  v[d] = rotr_x8(_mm256_xor_si256(v[d], v[a]), 16);
+  v[c] = _mm256_add_epi32(v[c], v[d]);
+  v[b] = rotr_x8(_mm256_xor_si256(v[b], v[c]), 12);
+  v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), y);
+  v[d] = rotr_x8(_mm256_xor_si256(v[d], v[a]), 8);
+  v[c] = _mm256_add_epi32(v[c], v[d]);
+  v[b] = rotr_x8(_mm256_xor_si256(v[b], v[c]), 7);
+}
+
+// Hashes eight consecutive full chunks, one per lane, into their chaining
+// values. None of them may be the root.
+__attribute__((target("avx2")))
+void hash_chunks_avx2_x8(
+  const uint32_t * key, const unsigned char * chunks, uint64_t counter, uint32_t flags,
+  uint32_t chaining_values[AVX2_CHUNKS][8])
+{
+  const __m256i offsets = _mm256_setr_epi32(
+    0, 1 * 1024, 2 * 1024, 3 * 1024, 4 * 1024, 5 * 1024, 6 * 1024, 7 * 1024);
+  uint32_t counter_low[AVX2_CHUNKS];
+  uint32_t counter_high[AVX2_CHUNKS];
+  for (size_t lane = 0; lane < AVX2_CHUNKS; ++lane) {
+    counter_low[lane] = static_cast<uint32_t>(counter + lane);
+    counter_high[lane] = static_cast<uint32_t>((counter + lane) >> 32);
+  }
+
+  __m256i cv[8];
+  for (size_t i = 0; i < 8; ++i) {
+    cv[i] = _mm256_set1_epi32(static_cast<int>(key[i]));
+  }
+
+  const size_t blocks = BbrBlake3Hasher::CHUNK_SIZE / BbrBlake3Hasher::BLOCK_SIZE;
+  for (size_t block = 0; block < blocks; ++block) {
+    __m256i m[16];
+    for (size_t i = 0; i < 16; ++i) {
+      m[i] = _mm256_i32gather_epi32(
+        reinterpret_cast<const int *>(chunks + block * BbrBlake3Hasher::BLOCK_SIZE + 4 * i),
+        offsets, 1);
+    }
+
+    uint32_t block_flags = flags | (block == 0 ? CHUNK_START : 0) |
+      (block == blocks - 1 ? CHUNK_END : 0);
+    __m256i v[16] = {
+      cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+      _mm256_set1_epi32(static_cast<int>(IV[0])), _mm256_set1_epi32(static_cast<int>(IV[1])),
+      _mm256_set1_epi32(static_cast<int>(IV[2])), _mm256_set1_epi32(static_cast<int>(IV[3])),
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(counter_low)),
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(counter_high)),
+      _mm256_set1_epi32(BbrBlake3Hasher::BLOCK_SIZE),
+      _mm256_set1_epi32(static_cast<int>(block_flags))
+    };
+
+    for (int round = 0; round < 7; ++round) {
+      g_x8(v, 0, 4, 8, 12, m[0], m[1]);
+      g_x8(v, 1, 5, 9, 13, m[2], m[3]);
+      g_x8(v, 2, 6, 10, 14, m[4], m[5]);
+      g_x8(v, 3, 7, 11, 15, m[6], m[7]);
+      g_x8(v, 0, 5, 10, 15, m[8], m[9]);
+      g_x8(v, 1, 6, 11, 12, m[10], m[11]);
+      g_x8(v, 2, 7, 8, 13, m[12], m[13]);
+      g_x8(v, 3, 4, 9, 14, m[14], m[15]);
+
+      __m256i permuted[16];
+      for (size_t i = 0; i < 16; ++i) {
+        permuted[i] = m[MESSAGE_PERMUTATION[i]];
+      }
+      std::copy(permuted, permuted + 16, m);
+    }
+
+    for (size_t i = 0; i < 8; ++i) {
+      cv[i] = _mm256_xor_si256(v[i], v[i + 8]);
+    }
+  }
+
+  uint32_t words[8][AVX2_CHUNKS];
+  for (size_t i = 0; i < 8; ++i) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[i]), cv[i]);
+  }
+  for (size_t lane = 0; lane < AVX2_CHUNKS; ++lane) {
+    for (size_t i = 0; i < 8; ++i) {
+      chaining_values[lane][i] = words[i][lane];
+    }
+  }
+}
+
+bool use_avx2()
+{
+  static const bool supported = isSha256BackendSupported(Sha256Backend::AVX2);
+  return supported;
+}
+
+#endif
+
+}  // namespace
+
+BbrBlake3Hasher::BbrBlake3Hasher()
+{
+  init();
+}
+
+void BbrBlake3Hasher::init()
+{
+  std::memcpy(key_, IV, sizeof(key_));
+  flags_ = 0;
+  cv_stack_size_ = 0;
+  reset_chunk(0);
+}
+
+void BbrBlake3Hasher::init_keyed(const unsigned char * key)
+{
+  for (size_t i = 0; i < 8; ++i) {
+    key_[i] = load_le32(key + 4 * i);
+  }
+  flags_ = KEYED_HASH;
+  cv_stack_size_ = 0;
+  reset_chunk(0);
+}
+
+void BbrBlake3Hasher::reset_chunk(uint64_t chunk_counter)
+{
+  std::memcpy(chunk_cv_, key_, sizeof(chunk_cv_));
+  chunk_counter_ = chunk_counter;
+  std::memset(block_, 0, sizeof(block_));
+  block_length_ = 0;
+  blocks_compressed_ = 0;
+}
+
+void BbrBlake3Hasher::compress_block(uint32_t extra_flags)
+{
+  uint32_t block_words[16];
+  load_block(block_, block_words);
+  uint32_t flags = flags_ | extra_flags | (blocks_compressed_ == 0 ? CHUNK_START : 0);
+  compress(chunk_cv_, block_words, chunk_counter_, static_cast<uint32_t>(block_length_), flags,
+    chunk_cv_);
+}
+
+void BbrBlake3Hasher::push_chunk(const uint32_t * chaining_value)
+{
+  // Each trailing zero bit of the chunk count completes one more subtree.
+  uint32_t cv[8];
+  std::memcpy(cv, chaining_value, sizeof(cv));
+  uint64_t total_chunks = chunk_counter_ + 1;
+  while ((total_chunks & 1) == 0) {
+    parent_cv(cv_stack_[--cv_stack_size_], cv, key_, flags_, cv);
+    total_chunks >>= 1;
+  }
+  std::memcpy(cv_stack_[cv_stack_size_++], cv, sizeof(cv));
+}
+
+void BbrBlake3Hasher::update(const void * data, size_t length)
+{
+  auto bytes = static_cast<const unsigned char *>(data);
+  while (length > 0) {
+    // A full chunk is only closed once more input arrives, since the last
+    // chunk has to be finalized with the root flag.
+    if (blocks_compressed_ * BLOCK_SIZE + block_length_ == CHUNK_SIZE) {
+      compress_block(CHUNK_END);
+      uint32_t chunk_cv[8];
+      std::memcpy(chunk_cv, chunk_cv_, sizeof(chunk_cv));
+      push_chunk(chunk_cv);
+      reset_chunk(chunk_counter_ + 1);
+    }
+#ifdef BBR_BLAKE3_X86
+    // Whole chunks are hashed eight at a time in AVX2 lanes while more input
+    // follows them; the tree above them is merged as usual.
+    if (blocks_compressed_ == 0 && block_length_ == 0 &&
+      length > AVX2_CHUNKS * CHUNK_SIZE && use_avx2())
+    {
+      uint32_t chaining_values[AVX2_CHUNKS][8];
+      hash_chunks_avx2_x8(key_, bytes, chunk_counter_, flags_, chaining_values);
+      for (size_t lane = 0; lane < AVX2_CHUNKS; ++lane) {
+        push_chunk(chaining_values[lane]);
+        reset_chunk(chunk_counter_ + 1);
+      }
+      bytes += AVX2_CHUNKS * CHUNK_SIZE;
+      length -= AVX2_CHUNKS * CHUNK_SIZE;
+      continue;
+    }
+#endif
+    if (block_length_ == BLOCK_SIZE) {
+      compress_block(0);
+      ++blocks_compressed_;
+      std::memset(block_, 0, sizeof(block_));
+      block_length_ = 0;
+    }
+    size_t take = std::min(length, BLOCK_SIZE - block_length_);
+    std::memcpy(block_ + block_length_, bytes, take);
+    block_length_ += take;
+    bytes += take;
+    length -= take;
+  }
+}
+
+void BbrBlake3Hasher::finalize(unsigned char * out)
+{
+  uint32_t block_words[16];
+  load_block(block_, block_words);
+  uint32_t chunk_flags = flags_ | CHUNK_END | (blocks_compressed_ == 0 ? CHUNK_START : 0);
+
+  uint32_t result[8];
+  if (cv_stack_size_ == 0) {
+    compress(chunk_cv_, block_words, chunk_counter_, static_cast<uint32_t>(block_length_),
+      chunk_flags | ROOT, result);
+  } else {
+    // Fold the open chunk into the stack from the right; the last parent
+    // is the root.
+    uint32_t cv[8];
+    compress(chunk_cv_, block_words, chunk_counter_, static_cast<uint32_t>(block_length_),
+      chunk_flags, cv);
+    for (size_t i = cv_stack_size_; i-- > 1; ) {
+      parent_cv(cv_stack_[i], cv, key_, flags_, cv);
+    }
+    uint32_t parent_words[16];
+    std::memcpy(parent_words, cv_stack_[0], sizeof(cv));
+    std::memcpy(parent_words + 8, cv, sizeof(cv));
+    compress(key_, parent_words, 0, BLOCK_SIZE, flags_ | PARENT | ROOT, result);
+  }
+
+  for (size_t i = 0; i < 8; ++i) {
+    out[4 * i] = static_cast<unsigned char>(result[i]);
+    out[4 * i + 1] = static_cast<unsigned char>(result[i] >> 8);
+    out[4 * i + 2] = static_cast<unsigned char>(result[i] >> 16);
+    out[4 * i + 3] = static_cast<unsigned char>(result[i] >> 24);
+  }
+}
+
+}  // namespace rosbag2_storage_plugins
@@ -0,0 +1,93 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_checkpoint_policy.hpp"
+
+#include <memory>
+#include <utility>
+
+namespace rosbag2_storage_plugins
+{
+
+EveryNthCheckpointPolicy::EveryNthCheckpointPolicy(size_t messages)
+: messages_(messages)
+{}
+
+bool EveryNthCheckpointPolicy::should_checkpoint(
+  const CheckpointState & state,
+  std::chrono::steady_clock::time_point now) const
+{
+  (void)now;
+  return state.messages >= messages_;
+}
+
+PeriodicCheckpointPolicy::PeriodicCheckpointPolicy(std::chrono::milliseconds period)
+: period_(period)
+{}
+
+bool PeriodicCheckpointPolicy::should_checkpoint(
+  const CheckpointState & state,
+  std::chrono::steady_clock::time_point now) const
+{
+  return now - state.last_checkpoint >= period_;
+}
+
+SizeCheckpointPolicy::SizeCheckpointPolicy(size_t bytes)
+: bytes_(bytes)
+{}
+
+bool SizeCheckpointPolicy::should_checkpoint(
+  const CheckpointState & state,
+  std::chrono::steady_clock::time_point now) const
+{
+  (void)now;
+  return state.bytes >= bytes_;
+}
+
+void AnyCheckpointPolicy::add(std::unique_ptr<CheckpointPolicy> policy)
+{
+  policies_.push_back(std::move(policy));
+}
+
+bool AnyCheckpointPolicy::should_checkpoint(
+  const CheckpointState & state,
+  std::chrono::steady_clock::time_point now) const
+{
+  for (const auto & policy : policies_) {
+    if (policy->should_checkpoint(state, now)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::unique_ptr<CheckpointPolicy> make_checkpoint_policy(
+  size_t every_n_messages,
+  std::chrono::milliseconds period,
+  size_t bytes)
+{
+  auto policy = std::make_unique<AnyCheckpointPolicy>();
+  if (every_n_messages > 0) {
+    policy->add(std::make_unique<EveryNthCheckpointPolicy>(every_n_messages));
+  }
+  if (period.count() > 0) {
+    policy->add(std::make_unique<PeriodicCheckpointPolicy>(period));
+  }
+  if (bytes > 0) {
+    policy->add(std::make_unique<SizeCheckpointPolicy>(bytes));
+  }
+  return policy;
+}
+
+}  // namespace rosbag2_storage_plugins
@@ -14,19 +14,21 @@
 
 #include "bbr_rosbag2_storage_plugin/bbr/bbr_helper.hpp"
 
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "rosbag2_storage/ros_helper.hpp"
 
 #include "Poco/HMACEngine.h"
-#include "Poco/MD5Engine.h"
-#include "Poco/DigestStream.h"
 #include "Poco/RandomStream.h"
-#include "Poco/StreamCopier.h"
 
 #include "bbr_protobuf/proto/bbr/hash.pb.h"
 
+#include "../logging.hpp"
+
 class SHA256Engine
   : public Poco::Crypto::DigestEngine
 {
@@ -45,14 +47,269 @@ public:
 namespace rosbag2_storage_plugins
 {
 
-BbrHelper::BbrHelper()
+uint8_t parseDigestAlgorithm(const std::string & name)
+{
+  if (name == "hmac_sha256") {
+    return DIGEST_ALGORITHM_HMAC_SHA256;
+  }
+  if (name == "blake3") {
+    return DIGEST_ALGORITHM_BLAKE3_KEYED;
+  }
+  throw std::invalid_argument("Unknown digest algorithm '" + name + "'.");
+}
+
+const char * getDigestAlgorithmName(uint8_t digest_algorithm)
+{
+  switch (digest_algorithm) {
+    case DIGEST_ALGORITHM_HMAC_SHA256:
+      return "hmac_sha256";
+    case DIGEST_ALGORITHM_BLAKE3_KEYED:
+      return "blake3";
+  }
+  return "unknown";
+}
+
+bool selfTestSha256Backend(Sha256Backend backend)
+{
+  if (!isSha256BackendSupported(backend)) {
+    return false;
+  }
+
+  const std::string rfc_key = "Jefe";
+  const std::string rfc_data = "what do ya want for nothing?";
+  const unsigned char rfc_digest[SHA256_DIGEST_SIZE] = {
+    0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+    0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+  };
+
+  const size_t data_lengths[] = {0, 1, 31, 55, 56, 63, 64, 65, 119, 120, 200, 1000, 5000};
+  const size_t key_lengths[] = {SHA256_DIGEST_SIZE, 100};
+  std::vector<unsigned char> data(5000);
+  std::vector<unsigned char> key(100);
+  const unsigned char header[] = {1, 0, 2, 3, 5, 7, 11, 13, 17, 19};
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<unsigned char>(i * 31 + 7);
+  }
+  for (size_t i = 0; i < key.size(); ++i) {
+    key[i] = static_cast<unsigned char>(i * 17 + 3);
+  }
+
+  std::vector<HmacSha256Job> jobs;
+  size_t job_count = 1 + sizeof(key_lengths) / sizeof(key_lengths[0]) *
+    sizeof(data_lengths) / sizeof(data_lengths[0]);
+  std::vector<unsigned char> digests(job_count * SHA256_DIGEST_SIZE);
+  jobs.push_back(
+    {
+      reinterpret_cast<const unsigned char *>(rfc_key.data()), rfc_key.size(),
+      nullptr, 0, rfc_data.data(), rfc_data.size(), digests.data()
+    });
+  for (auto key_length : key_lengths) {
+    for (auto data_length : data_lengths) {
+      jobs.push_back(
+        {
+          key.data(), key_length, header, sizeof(header), data.data(), data_length,
+          digests.data() + jobs.size() * SHA256_DIGEST_SIZE
+        });
+    }
+  }
+  computeHmacSha256(jobs.data(), jobs.size(), backend);
+
+  if (std::memcmp(jobs[0].digest, rfc_digest, SHA256_DIGEST_SIZE) != 0) {
+    return false;
+  }
+  for (size_t i = 1; i < jobs.size(); ++i) {
+    Poco::HMACEngine<SHA256Engine> hmac(
+      reinterpret_cast<const char *>(jobs[i].key), jobs[i].key_length);
+    hmac.update(jobs[i].header, jobs[i].header_size);
+    hmac.update(jobs[i].data, jobs[i].data_length);
+    const auto & expected = hmac.digest();
+    if (std::memcmp(jobs[i].digest, expected.data(), SHA256_DIGEST_SIZE) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool selfTestBlake3()
+{
+  // Test vector inputs are the repeating byte sequence 0, 1, ..., 250.
+  struct Vector
+  {
+    size_t length;
+    bool keyed;
+    unsigned char digest[BbrBlake3Hasher::OUT_SIZE];
+  };
+  const Vector vectors[] = {
+    {
+      0, false,
+      {
+        0xaf, 0x13, 0x49, 0xb9, 0xf5, 0xf9, 0xa1, 0xa6, 0xa0, 0x40, 0x4d, 0xea, 0x36, 0xdc, 0xc9,
+        0x49, 0x9b, 0xcb, 0x25, 0xc9, 0xad, 0xc1, 0x12, 0xb7, 0xcc, 0x9a, 0x93, 0xca, 0xe4, 0x1f,
+        0x32, 0x62
+      }
+    },
+    {
+      1024, false,
+      {
+        0x42, 0x21, 0x47, 0x39, 0xf0, 0x95, 0xa4, 0x06, 0xf3, 0xfc, 0x83, 0xde, 0xb8, 0x89, 0x74,
+        0x4a, 0xc0, 0x0d, 0xf8, 0x31, 0xc1, 0x0d, 0xaa, 0x55, 0x18, 0x9b, 0x5d, 0x12, 0x1c, 0x85,
+        0x5a, 0xf7
+      }
+    },
+    {
+      1025, false,
+      {
+        0xd0, 0x02, 0x78, 0xae, 0x47, 0xeb, 0x27, 0xb3, 0x4f, 0xae, 0xcf, 0x67, 0xb4, 0xfe, 0x26,
+        0x3f, 0x82, 0xd5, 0x41, 0x29, 0x16, 0xc1, 0xff, 0xd9, 0x7c, 0x8c, 0xb7, 0xfb, 0x81, 0x4b,
+        0x84, 0x44
+      }
+    },
+    {
+      102400, false,
+      {
+        0xbc, 0x3e, 0x3d, 0x41, 0xa1, 0x14, 0x6b, 0x06, 0x9a, 0xbf, 0xfa, 0xd3, 0xc0, 0xd4, 0x48,
+        0x60, 0xcf, 0x66, 0x43, 0x90, 0xaf, 0xce, 0x4d, 0x96, 0x61, 0xf7, 0x90, 0x2e, 0x79, 0x43,
+        0xe0, 0x85
+      }
+    },
+    {
+      0, true,
+      {
+        0x92, 0xb2, 0xb7, 0x56, 0x04, 0xed, 0x3c, 0x76, 0x1f, 0x9d, 0x6f, 0x62, 0x39, 0x2c, 0x8a,
+        0x92, 0x27, 0xad, 0x0e, 0xa3, 0xf0, 0x95, 0x73, 0xe7, 0x83, 0xf1, 0x49, 0x8a, 0x4e, 0xd6,
+        0x0d, 0x26
+      }
+    }
+  };
+  const char key[] = "whats the Elvish word for friend";
+
+  std::vector<unsigned char> data(102400);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<unsigned char>(i % 251);
+  }
+
+  BbrBlake3Hasher hasher;
+  for (const auto & vector : vectors) {
+    if (vector.keyed) {
+      hasher.init_keyed(reinterpret_cast<const unsigned char *>(key));
+    } else {
+      hasher.init();
+    }
+    hasher.update(data.data(), vector.length);
+    unsigned char digest[BbrBlake3Hasher::OUT_SIZE];
+    hasher.finalize(digest);
+    if (std::memcmp(digest, vector.digest, sizeof(digest)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BbrHmacContext::BbrHmacContext()
+: hasher_(BbrHelper::getSha256Backend()),
+  digest_(SHA256_DIGEST_SIZE)
 {}
 
+void BbrHmacContext::init(const unsigned char * key, size_t length)
+{
+  unsigned char key_block[BLOCK_SIZE] = {};
+  if (length > BLOCK_SIZE) {
+    hasher_.init();
+    hasher_.update(key, length);
+    hasher_.finalize(key_block);
+  } else {
+    std::memcpy(key_block, key, length);
+  }
+
+  unsigned char ipad[BLOCK_SIZE];
+  for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+    ipad[i] = key_block[i] ^ 0x36;
+    opad_[i] = key_block[i] ^ 0x5c;
+  }
+
+  hasher_.init();
+  hasher_.update(ipad, BLOCK_SIZE);
+}
+
+void BbrHmacContext::update(const void * data, size_t length)
+{
+  hasher_.update(data, length);
+}
+
+const Poco::DigestEngine::Digest & BbrHmacContext::digest()
+{
+  unsigned char inner[SHA256_DIGEST_SIZE];
+  hasher_.finalize(inner);
+
+  hasher_.init();
+  hasher_.update(opad_, BLOCK_SIZE);
+  hasher_.update(inner, sizeof(inner));
+  hasher_.finalize(digest_.data());
+  return digest_;
+}
+
+MessageHeader encodeMessageHeader(
+  rcutils_time_point_value_t time_stamp,
+  bool has_sequence,
+  uint64_t sequence)
+{
+  MessageHeader header;
+  header.data[0] = MESSAGE_FORMAT_CANONICAL;
+  header.data[1] = has_sequence ? MESSAGE_HEADER_HAS_SEQUENCE : 0;
+  header.size = 2;
+
+  uint64_t stamp = static_cast<uint64_t>(time_stamp);
+  for (size_t i = 0; i < sizeof(stamp); ++i) {
+    header.data[header.size++] = static_cast<uint8_t>(stamp >> (8 * i));
+  }
+  if (has_sequence) {
+    for (size_t i = 0; i < sizeof(sequence); ++i) {
+      header.data[header.size++] = static_cast<uint8_t>(sequence >> (8 * i));
+    }
+  }
+  return header;
+}
+
+BbrHelper::BbrHelper(uint8_t message_format, uint8_t digest_algorithm)
+: message_format_(message_format)
+{
+  setDigestAlgorithm(digest_algorithm);
+}
+
+void BbrHelper::setMessageFormat(uint8_t message_format)
+{
+  message_format_ = message_format;
+}
+
+uint8_t BbrHelper::getMessageFormat() const
+{
+  return message_format_;
+}
+
+void BbrHelper::setDigestAlgorithm(uint8_t digest_algorithm)
+{
+  if (digest_algorithm == DIGEST_ALGORITHM_BLAKE3_KEYED) {
+    // Checked once per process, like the SHA-256 backends.
+    static const bool blake3_ok = selfTestBlake3();
+    if (!blake3_ok) {
+      throw std::runtime_error("BLAKE3 failed its self-test.");
+    }
+  } else if (digest_algorithm != DIGEST_ALGORITHM_HMAC_SHA256) {
+    throw std::invalid_argument("Unknown digest algorithm.");
+  }
+  digest_algorithm_ = digest_algorithm;
+}
+
+uint8_t BbrHelper::getDigestAlgorithm() const
+{
+  return digest_algorithm_;
+}
+
 std::shared_ptr<rcutils_uint8_array_t> BbrHelper::createNonce()
 {
-  char nonce[SHA256Engine::DIGEST_SIZE];
+  char nonce[NONCE_SIZE];
   Poco::RandomInputStream rnd;
-  rnd.read(nonce, SHA256Engine::DIGEST_SIZE);
+  rnd.read(nonce, NONCE_SIZE);
 //  char seed[] = { 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
 //                  0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
 //                  0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
@@ -60,7 +317,7 @@ std::shared_ptr<rcutils_uint8_array_t> BbrHelper::createNonce()
 //  std::string str_nonce(nonce);
 //  std::cout << "Nonce: " << str_nonce;
 
-  return rosbag2_storage::make_serialized_message(nonce, SHA256Engine::DIGEST_SIZE);
+  return rosbag2_storage::make_serialized_message(nonce, NONCE_SIZE);
 }
 
 
@@ -68,45 +325,31 @@ std::shared_ptr<rcutils_uint8_array_t> BbrHelper::computeTopicDigest(
   std::shared_ptr<rcutils_uint8_array_t> nonce,
   const rosbag2_storage::TopicMetadata & topic)
 {
-  std::string nonce_passphrase(
-    reinterpret_cast<char *>(nonce->buffer),
-    nonce->buffer_length);
-
   std::string topic_format_str;
   auto topic_format = TopicFormat();
   topic_format.set_type(topic.type);
   topic_format.set_serialization_format(topic.serialization_format);
   topic_format.SerializeToString(&topic_format_str);
 
-  std::istringstream topic_format_istr(topic_format_str);
-  auto topic_digest = computeHMAC(nonce_passphrase, topic_format_istr);
-
-  std::string topic_passphrase(
-    reinterpret_cast<char *>(topic_digest.data()),
-    topic_digest.size());
+  const auto & topic_digest = computeHMAC(*nonce, topic_format_str);
 
-  char * hash = reinterpret_cast<char *>(topic_digest.data());
-  return rosbag2_storage::make_serialized_message(hash, SHA256Engine::DIGEST_SIZE);
+  const char * hash = reinterpret_cast<const char *>(topic_digest.data());
+  return rosbag2_storage::make_serialized_message(hash, DIGEST_SIZE);
 }
 
 std::shared_ptr<rcutils_uint8_array_t> BbrHelper::computeTopicNonce(
   std::shared_ptr<rcutils_uint8_array_t> nonce,
   const rosbag2_storage::TopicMetadata & topic)
 {
-  std::string topic_passphrase(
-    reinterpret_cast<char *>(nonce->buffer),
-    nonce->buffer_length);
-
   std::string topic_info_str;
   auto topic_info = TopicInfo();
   topic_info.set_name(topic.name);
   topic_info.SerializeToString(&topic_info_str);
 
-  std::istringstream topic_info_istr(topic_info_str);
-  auto topic_nonce = computeHMAC(topic_passphrase, topic_info_istr);
+  const auto & topic_nonce = computeHMAC(*nonce, topic_info_str);
 
-  char * hash = reinterpret_cast<char *>(topic_nonce.data());
-  return rosbag2_storage::make_serialized_message(hash, SHA256Engine::DIGEST_SIZE);
+  const char * hash = reinterpret_cast<const char *>(topic_nonce.data());
+  return rosbag2_storage::make_serialized_message(hash, DIGEST_SIZE);
 }
 
 
@@ -114,51 +357,194 @@ std::shared_ptr<rcutils_uint8_array_t> BbrHelper::computeMessageDigest(
   std::shared_ptr<rcutils_uint8_array_t> nonce,
   std::shared_ptr<const rosbag2_storage::SerializedBagMessage> message)
 {
-  std::string message_passphrase(
-    reinterpret_cast<char *>(nonce->buffer),
-    nonce->buffer_length);
+  return computeMessageDigest(*nonce, message->time_stamp, *message->serialized_data);
+}
 
-  std::string message_info_str;
-  auto message_info = MessageInfo();
-  message_info.set_stamp(message->time_stamp);
-  message_info.SerializeToString(&message_info_str);
+std::shared_ptr<rcutils_uint8_array_t> BbrHelper::computeMessageDigest(
+  const rcutils_uint8_array_t & nonce,
+  rcutils_time_point_value_t time_stamp,
+  const rcutils_uint8_array_t & data)
+{
+  MessageHeader header;
+  const void * header_data;
+  size_t header_size;
+  if (message_format_ == MESSAGE_FORMAT_PROTOBUF) {
+    // Legacy encoding, kept so that bags recorded before bbr_format verify.
+    auto message_info = MessageInfo();
+    message_info.set_stamp(time_stamp);
+    message_info.SerializeToString(&message_info_str_);
+    header_data = message_info_str_.data();
+    header_size = message_info_str_.size();
+  } else {
+    header = encodeMessageHeader(time_stamp);
+    header_data = header.data;
+    header_size = header.size;
+  }
 
-  std::string message_data_str(
-    reinterpret_cast<char *>(message->serialized_data->buffer),
-    message->serialized_data->buffer_length);
+  if (digest_algorithm_ == DIGEST_ALGORITHM_BLAKE3_KEYED) {
+    unsigned char digest[DIGEST_SIZE];
+    computeKeyedBlake3(nonce, header_data, header_size, data, digest);
+    return rosbag2_storage::make_serialized_message(digest, DIGEST_SIZE);
+  }
+
+  const auto & message_digest = computeHMAC(nonce, header_data, header_size, data);
+
+  const char * hash = reinterpret_cast<const char *>(message_digest.data());
+  return rosbag2_storage::make_serialized_message(hash, DIGEST_SIZE);
+}
+
+std::shared_ptr<rcutils_uint8_array_t> BbrHelper::computeSegmentKey(
+  const rcutils_uint8_array_t & nonce,
+  uint64_t segment_index)
+{
+  auto header = encodeMessageHeader(0, true, segment_index);
+  header.data[1] |= MESSAGE_HEADER_SEGMENT;
 
-  std::istringstream topic_info_istr(message_info_str);
-  std::istringstream topic_data_istr(message_data_str);
-  auto message_digest = computeHMAC(message_passphrase, topic_info_istr, topic_data_istr);
+  hmac_.init(nonce.buffer, nonce.buffer_length);
+  hmac_.update(header.data, header.size);
+  const auto & segment_key = hmac_.digest();
 
-  char * hash = reinterpret_cast<char *>(message_digest.data());
-  return rosbag2_storage::make_serialized_message(hash, SHA256Engine::DIGEST_SIZE);
+  const char * hash = reinterpret_cast<const char *>(segment_key.data());
+  return rosbag2_storage::make_serialized_message(hash, DIGEST_SIZE);
+}
+
+std::shared_ptr<rcutils_uint8_array_t> BbrHelper::computeSegmentLink(
+  const rcutils_uint8_array_t & previous_link,
+  uint64_t segment_index,
+  const rcutils_uint8_array_t & root)
+{
+  auto header = encodeMessageHeader(0, true, segment_index);
+  header.data[1] |= MESSAGE_HEADER_SEGMENT;
+
+  const auto & segment_link = computeHMAC(previous_link, header.data, header.size, root);
+
+  const char * hash = reinterpret_cast<const char *>(segment_link.data());
+  return rosbag2_storage::make_serialized_message(hash, DIGEST_SIZE);
+}
+
+Sha256Backend BbrHelper::getSha256Backend()
+{
+  static const Sha256Backend backend = []() {
+      const Sha256Backend candidates[] = {
+        detectSha256Backend(), Sha256Backend::SHA_NI, Sha256Backend::AVX2, Sha256Backend::SCALAR
+      };
+      for (auto candidate : candidates) {
+        if (selfTestSha256Backend(candidate)) {
+          return candidate;
+        }
+        if (isSha256BackendSupported(candidate)) {
+          ROSBAG2_STORAGE_DEFAULT_PLUGINS_LOG_ERROR(
+            "SHA-256 backend '%s' failed its self-test.", getSha256BackendName(candidate));
+        }
+      }
+      throw std::runtime_error("No SHA-256 backend passed its self-test.");
+    }();
+  return backend;
+}
+
+void BbrHelper::computeMessageDigests(std::vector<MessageDigestJob> & jobs)
+{
+  const unsigned char empty[DIGEST_SIZE] = {};
+  std::vector<MessageHeader> headers(jobs.size());
+  std::vector<std::string> message_infos;
+  if (message_format_ == MESSAGE_FORMAT_PROTOBUF) {
+    message_infos.resize(jobs.size());
+  }
+
+  std::vector<HmacSha256Job> hmac_jobs(jobs.size());
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    auto & job = jobs[i];
+    job.digest = rosbag2_storage::make_serialized_message(empty, DIGEST_SIZE);
+
+    auto & hmac_job = hmac_jobs[i];
+    hmac_job.key = job.nonce->buffer;
+    hmac_job.key_length = job.nonce->buffer_length;
+    if (message_format_ == MESSAGE_FORMAT_PROTOBUF) {
+      auto message_info = MessageInfo();
+      message_info.set_stamp(job.time_stamp);
+      message_info.SerializeToString(&message_infos[i]);
+      hmac_job.header = message_infos[i].data();
+      hmac_job.header_size = message_infos[i].size();
+    } else {
+      headers[i] = encodeMessageHeader(job.time_stamp);
+      hmac_job.header = headers[i].data;
+      hmac_job.header_size = headers[i].size;
+    }
+    hmac_job.data = job.data->buffer;
+    hmac_job.data_length = job.data->buffer_length;
+    hmac_job.digest = job.digest->buffer;
+  }
+
+  if (digest_algorithm_ == DIGEST_ALGORITHM_BLAKE3_KEYED) {
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      computeKeyedBlake3(
+        *jobs[i].nonce, hmac_jobs[i].header, hmac_jobs[i].header_size, *jobs[i].data,
+        hmac_jobs[i].digest);
+    }
+    return;
+  }
+  computeHmacSha256(hmac_jobs.data(), hmac_jobs.size(), getSha256Backend());
+}
+
+bool BbrHelper::verifyMessageDigest(
+  const rcutils_uint8_array_t & nonce,
+  rcutils_time_point_value_t time_stamp,
+  const rcutils_uint8_array_t & data,
+  const rcutils_uint8_array_t & digest)
+{
+  auto expected = computeMessageDigest(nonce, time_stamp, data);
+  if (digest.buffer_length != expected->buffer_length) {
+    return false;
+  }
+
+  // Constant time comparison, the digest doubles as the next chain key.
+  unsigned char difference = 0;
+  for (size_t i = 0; i < digest.buffer_length; ++i) {
+    difference |= digest.buffer[i] ^ expected->buffer[i];
+  }
+  return difference == 0;
+}
+
+const Poco::DigestEngine::Digest & BbrHelper::computeHMAC(
+  const rcutils_uint8_array_t & passphrase,
+  const std::string & info)
+{
+  hmac_.init(passphrase.buffer, passphrase.buffer_length);
+  hmac_.update(info.data(), info.size());
+  return hmac_.digest();
 }
 
-Poco::DigestEngine::Digest BbrHelper::computeHMAC(
-  std::string passphrase,
-  std::istringstream & istr)
+const Poco::DigestEngine::Digest & BbrHelper::computeHMAC(
+  const rcutils_uint8_array_t & passphrase,
+  const void * header,
+  size_t header_size,
+  const rcutils_uint8_array_t & data)
 {
-  //TODO: rework to allow utilize protobuf SerializeToOstream
-  Poco::HMACEngine<SHA256Engine> hmac(passphrase);
-  Poco::DigestOutputStream dos(hmac);
-  Poco::StreamCopier::copyStream(istr, dos);
-  dos.close();
-  return hmac.digest();
+  hmac_.init(passphrase.buffer, passphrase.buffer_length);
+  hmac_.update(header, header_size);
+  hmac_.update(data.buffer, data.buffer_length);
+  return hmac_.digest();
 }
 
-Poco::DigestEngine::Digest BbrHelper::computeHMAC(
-  std::string passphrase,
-  std::istringstream & istr1,
-  std::istringstream & istr2)
+void BbrHelper::computeKeyedBlake3(
+  const rcutils_uint8_array_t & nonce,
+  const void * header,
+  size_t header_size,
+  const rcutils_uint8_array_t & data,
+  unsigned char * digest)
 {
-  //TODO: rework to allow utilize protobuf SerializeToOstream
-  Poco::HMACEngine<SHA256Engine> hmac(passphrase);
-  Poco::DigestOutputStream dos(hmac);
-  Poco::StreamCopier::copyStream(istr1, dos);
-  Poco::StreamCopier::copyStream(istr2, dos);
-  dos.close();
-  return hmac.digest();
+  if (nonce.buffer_length == BbrBlake3Hasher::KEY_SIZE) {
+    blake3_.init_keyed(nonce.buffer);
+  } else {
+    unsigned char key[BbrBlake3Hasher::KEY_SIZE];
+    blake3_.init();
+    blake3_.update(nonce.buffer, nonce.buffer_length);
+    blake3_.finalize(key);
+    blake3_.init_keyed(key);
+  }
+  blake3_.update(header, header_size);
+  blake3_.update(data.buffer, data.buffer_length);
+  blake3_.finalize(digest);
 }
 
 }  // namespace rosbag2_storage_plugins
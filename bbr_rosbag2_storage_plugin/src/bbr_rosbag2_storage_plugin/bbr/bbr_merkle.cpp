@@ -0,0 +1,157 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_merkle.hpp"
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_helper.hpp"
+
+namespace rosbag2_storage_plugins
+{
+
+namespace
+{
+
+const unsigned char LEAF_PREFIX = 0x00;
+const unsigned char NODE_PREFIX = 0x01;
+
+size_t split_point(size_t count)
+{
+  size_t split = 1;
+  while (split * 2 < count) {
+    split *= 2;
+  }
+  return split;
+}
+
+}  // namespace
+
+BbrMerkleAccumulator::BbrMerkleAccumulator()
+: engine_(DIGEST_ENGINE_NAME),
+  size_(0)
+{}
+
+void BbrMerkleAccumulator::append(const unsigned char * digest, size_t length)
+{
+  peaks_.emplace_back(1, hash_leaf(digest, length));
+  ++size_;
+
+  while (peaks_.size() > 1 && peaks_[peaks_.size() - 2].first == peaks_.back().first) {
+    auto right = std::move(peaks_.back());
+    peaks_.pop_back();
+    auto & left = peaks_.back();
+    left.second = hash_node(left.second, right.second);
+    left.first += right.first;
+  }
+}
+
+size_t BbrMerkleAccumulator::size() const
+{
+  return size_;
+}
+
+void BbrMerkleAccumulator::reset()
+{
+  peaks_.clear();
+  size_ = 0;
+}
+
+BbrMerkleAccumulator::Digest BbrMerkleAccumulator::root()
+{
+  if (peaks_.empty()) {
+    engine_.reset();
+    return engine_.digest();
+  }
+
+  // Peaks shrink from left to right, so folding them from the right yields
+  // the same root as splitting at the largest power of two.
+  Digest root = peaks_.back().second;
+  for (size_t i = peaks_.size() - 1; i-- > 0; ) {
+    root = hash_node(peaks_[i].second, root);
+  }
+  return root;
+}
+
+std::vector<BbrMerkleAccumulator::ProofStep> BbrMerkleAccumulator::prove(
+  const std::vector<Digest> & leaves, size_t index)
+{
+  if (index >= leaves.size()) {
+    throw std::out_of_range("Merkle proof index is out of range.");
+  }
+
+  std::vector<ProofStep> proof;
+  prove(leaves, 0, leaves.size(), index, proof);
+  return proof;
+}
+
+bool BbrMerkleAccumulator::verify(
+  const Digest & leaf, const std::vector<ProofStep> & proof, const Digest & root)
+{
+  Digest node = hash_leaf(leaf.data(), leaf.size());
+  for (const auto & step : proof) {
+    node = step.left ? hash_node(step.sibling, node) : hash_node(node, step.sibling);
+  }
+  return node == root;
+}
+
+BbrMerkleAccumulator::Digest BbrMerkleAccumulator::hash_leaf(
+  const unsigned char * digest, size_t length)
+{
+  engine_.reset();
+  engine_.update(&LEAF_PREFIX, 1);
+  engine_.update(digest, length);
+  return engine_.digest();
+}
+
+BbrMerkleAccumulator::Digest BbrMerkleAccumulator::hash_node(
+  const Digest & left, const Digest & right)
+{
+  engine_.reset();
+  engine_.update(&NODE_PREFIX, 1);
+  engine_.update(left.data(), left.size());
+  engine_.update(right.data(), right.size());
+  return engine_.digest();
+}
+
+BbrMerkleAccumulator::Digest BbrMerkleAccumulator::subtree_root(
+  const std::vector<Digest> & leaves, size_t begin, size_t end)
+{
+  if (end - begin == 1) {
+    return hash_leaf(leaves[begin].data(), leaves[begin].size());
+  }
+  size_t split = begin + split_point(end - begin);
+  return hash_node(subtree_root(leaves, begin, split), subtree_root(leaves, split, end));
+}
+
+void BbrMerkleAccumulator::prove(
+  const std::vector<Digest> & leaves, size_t begin, size_t end, size_t index,
+  std::vector<ProofStep> & proof)
+{
+  if (end - begin == 1) {
+    return;
+  }
+  size_t split = begin + split_point(end - begin);
+  if (index < split) {
+    prove(leaves, begin, split, index, proof);
+    proof.push_back({subtree_root(leaves, split, end), false});
+  } else {
+    prove(leaves, split, end, index, proof);
+    proof.push_back({subtree_root(leaves, begin, split), true});
+  }
+}
+
+}  // namespace rosbag2_storage_plugins
@@ -14,24 +14,132 @@
 
 #include "bbr_rosbag2_storage_plugin/bbr/bbr_node.hpp"
 
+#include <algorithm>
+#include <future>
+#include <utility>
+#include <vector>
+
 
 namespace rosbag2_storage_plugins
 {
 
+namespace
+{
+
+// Longest the spin thread waits for work before checking whether to stop.
+const std::chrono::milliseconds SPIN_TIMEOUT(100);
+
+}  // namespace
+
 BbrNode::BbrNode(const std::string & node_name)
 : rclcpp::Node(node_name)
 {
+  // Messages wrapped in a single transaction before committing; 1 commits each
+  // message on its own. Larger values trade crash durability for throughput.
+  this->declare_parameter("group_commit_messages", 1);
+  // Maximum age of an open transaction before it is committed.
+  this->declare_parameter("group_commit_period_ms", 100);
+  // Hash, insert and checkpoint on a dedicated writer thread.
+  this->declare_parameter("async_write", false);
+  // Capacity of the writer queue, rounded up to a power of two.
+  this->declare_parameter("async_queue_size", 4096);
+  // Behaviour when the writer queue is full: block, drop_oldest or drop_newest.
+  this->declare_parameter("async_overflow_policy", std::string("block"));
+  // Checkpoints per CheckpointArray before a record's batch is published.
+  this->declare_parameter("checkpoint_batch_size", 100);
+  // Approximate payload bytes per CheckpointArray before a batch is published.
+  this->declare_parameter("checkpoint_batch_bytes", 64 * 1024);
+  // Maximum time a checkpoint waits in a batch before it is published.
+  this->declare_parameter("checkpoint_linger_ms", 100);
+  // Anchor every Nth digest of a topic chain; 0 disables this trigger.
+  this->declare_parameter("checkpoint_every_n", 1);
+  // Anchor a topic's latest digest after this many milliseconds; 0 disables.
+  this->declare_parameter("checkpoint_period_ms", 0);
+  // Anchor once this many payload bytes are unanchored; 0 disables.
+  this->declare_parameter("checkpoint_bytes", 0);
+  // Time to wait for a record confirmation before retrying.
+  this->declare_parameter("record_timeout_ms", 5000);
+  // Attempts to create a record before it is marked as failed.
+  this->declare_parameter("record_max_attempts", 3);
+  // Records created within this window are sent in one CreateRecords request.
+  this->declare_parameter("record_batch_window_ms", 50);
+  // Maximum records per CreateRecords request.
+  this->declare_parameter("record_batch_size", 100);
+  // Time to wait for the record service before warning that it is missing.
+  this->declare_parameter("service_timeout_ms", 10000);
+  // Anchor the Merkle root over each checkpoint window instead of the last
+  // chain digest, so single messages can be proven with a short path.
+  this->declare_parameter("checkpoint_merkle", false);
+  // Restart each topic's digest chain every N messages so a single topic
+  // verifies in parallel; 0 keeps one chain per topic.
+  this->declare_parameter("chain_segment_size", 0);
+  // Keyed function chaining message digests in new bags: hmac_sha256, or
+  // blake3 for faster hashing of large messages.
+  this->declare_parameter("digest_algorithm", std::string("hmac_sha256"));
+  // Database setup for new bags: default, or bulk_load to defer secondary
+  // indexes until close and apply the pragmas below.
+  this->declare_parameter("recording_profile", std::string("default"));
+  // Page size in bytes for bulk_load bags.
+  this->declare_parameter("sqlite_page_size", 65536);
+  // Page cache in KiB for bulk_load bags.
+  this->declare_parameter("sqlite_cache_size_kb", 256 * 1024);
+
+  checkpoint_batch_size_ = static_cast<size_t>(
+    this->get_parameter("checkpoint_batch_size").as_int());
+  checkpoint_batch_bytes_ = static_cast<size_t>(
+    this->get_parameter("checkpoint_batch_bytes").as_int());
+  checkpoint_linger_ = std::chrono::milliseconds(
+    this->get_parameter("checkpoint_linger_ms").as_int());
+  record_timeout_ = std::chrono::milliseconds(
+    this->get_parameter("record_timeout_ms").as_int());
+  record_max_attempts_ = static_cast<size_t>(
+    this->get_parameter("record_max_attempts").as_int());
+  record_batch_window_ = std::chrono::milliseconds(
+    this->get_parameter("record_batch_window_ms").as_int());
+  record_batch_size_ = static_cast<size_t>(
+    this->get_parameter("record_batch_size").as_int());
+  service_timeout_ = std::chrono::milliseconds(
+    this->get_parameter("service_timeout_ms").as_int());
+
   checkpoints_publisher_ =
     this->create_publisher<bbr_msgs::msg::CheckpointArray>("checkpoints", 10);
+  // The record service is discovered in the background; records queue up
+  // until it appears, however long that takes.
   records_client_ = this->create_client<bbr_msgs::srv::CreateRecords>("create_records");
-  while (!records_client_->wait_for_service(std::chrono::seconds(1))) {
-    if (!rclcpp::ok()) {
-      RCLCPP_ERROR(
-        this->get_logger(), "record client interrupted while waiting for service to appear.");
-      throw std::runtime_error(
-              "Failed to connect to record service.");
-    }
-    RCLCPP_INFO(this->get_logger(), "waiting for record service to appear...");
+  discovery_start_ = std::chrono::steady_clock::now();
+  service_available_ = false;
+  service_warned_ = false;
+
+  // Check at twice the linger rate so no batch outlives its limit by much.
+  timer_ = this->create_wall_timer(
+    std::max(checkpoint_linger_ / 2, std::chrono::milliseconds(1)),
+    std::bind(&BbrNode::flush_expired_checkpoints, this));
+  records_timer_ = this->create_wall_timer(
+    std::max(record_batch_window_ / 2, std::chrono::milliseconds(1)),
+    std::bind(&BbrNode::check_records, this));
+
+  executor_.add_node(this->get_node_base_interface());
+  spinning_ = true;
+  spin_thread_ = std::thread(&BbrNode::run_executor, this);
+}
+
+BbrNode::~BbrNode()
+{
+  flush_checkpoints();
+  spinning_ = false;
+  executor_.cancel();
+  if (spin_thread_.joinable()) {
+    spin_thread_.join();
+  }
+}
+
+void BbrNode::run_executor()
+{
+  // spin() would miss a cancel() issued before it starts and then never
+  // return, so the executor is spun in bounded steps until spinning_ is
+  // cleared.
+  while (spinning_) {
+    executor_.spin_once(SPIN_TIMEOUT);
   }
 }
 
@@ -61,49 +169,228 @@ void BbrNode::create_record(
   record.message_type = topic.type;
   record.serialization_format = topic.serialization_format;
 
-  auto record_array = bbr_msgs::msg::RecordArray();
-  record_array.records.push_back(record);
+  PendingRecord pending;
+  pending.record = record;
+  pending.status = RecordStatus::PENDING;
+  pending.attempts = 0;
+  pending.queued = false;
 
-  auto request = std::make_shared<bbr_msgs::srv::CreateRecords::Request>();
-  request->record_array = record_array;
+  // Records created within record_batch_window_ms share one request.
+  RecordRequest record_request;
+  {
+    std::lock_guard<std::mutex> lock(records_mutex_);
+    auto record_entry = records_.emplace(topic.name, std::move(pending)).first;
+    queue_record(record_entry->second);
+    if (queued_records_.size() < record_batch_size_ || !service_available_ ||
+      !prepare_record_request(record_request))
+    {
+      return;
+    }
+  }
+  send_record_request(record_request);
+}
 
-  auto result_future = records_client_->async_send_request(request);
-  if (rclcpp::spin_until_future_complete(this->get_node_base_interface(), result_future) !=
-    rclcpp::executor::FutureReturnCode::SUCCESS)
+BbrNode::RecordStatus BbrNode::get_record_status(const std::string & topic_name) const
+{
+  std::lock_guard<std::mutex> lock(records_mutex_);
+  auto record_entry = records_.find(topic_name);
+  if (record_entry == end(records_)) {
+    return RecordStatus::UNKNOWN;
+  }
+  return record_entry->second.status;
+}
+
+void BbrNode::queue_record(PendingRecord & pending)
+{
+  if (pending.queued) {
+    return;
+  }
+  if (queued_records_.empty()) {
+    queued_since_ = std::chrono::steady_clock::now();
+  }
+  pending.queued = true;
+  queued_records_.push_back(pending.record.topic_name);
+}
+
+bool BbrNode::prepare_record_request(RecordRequest & record_request)
+{
+  auto now = std::chrono::steady_clock::now();
+  record_request.attempts.clear();
+  record_request.request = std::make_shared<bbr_msgs::srv::CreateRecords::Request>();
+  for (const auto & topic_name : queued_records_) {
+    auto & pending = records_.at(topic_name);
+    pending.queued = false;
+    ++pending.attempts;
+    pending.sent = now;
+    record_request.attempts.emplace_back(topic_name, pending.attempts);
+    record_request.request->record_array.records.push_back(pending.record);
+  }
+  queued_records_.clear();
+  return !record_request.attempts.empty();
+}
+
+void BbrNode::send_record_request(const RecordRequest & record_request)
+{
+  // Sent without holding records_mutex_, which the response callback takes.
+  RCLCPP_DEBUG(this->get_logger(), "Sending %zu records",
+    record_request.attempts.size());
+  records_client_->async_send_request(
+    record_request.request,
+    std::bind(
+      &BbrNode::handle_record_response, this,
+      record_request.attempts, std::placeholders::_1));
+}
+
+void BbrNode::handle_record_response(
+  const RecordRequest::Attempts & attempts,
+  rclcpp::Client<bbr_msgs::srv::CreateRecords>::SharedFuture result_future)
+{
+  bool success = result_future.get()->success;
+
+  std::lock_guard<std::mutex> lock(records_mutex_);
+  for (const auto & attempt : attempts) {
+    auto record_entry = records_.find(attempt.first);
+    if (record_entry == end(records_)) {
+      continue;
+    }
+    auto & pending = record_entry->second;
+    // Responses to attempts that already timed out are superseded by the retry.
+    if (pending.status != RecordStatus::PENDING || pending.queued ||
+      pending.attempts != attempt.second)
+    {
+      continue;
+    }
+
+    if (success) {
+      pending.status = RecordStatus::CREATED;
+      RCLCPP_DEBUG(this->get_logger(), "record created: '%s'", attempt.first.c_str());
+    } else {
+      retry_record(pending, "record was not created");
+    }
+  }
+}
+
+void BbrNode::retry_record(PendingRecord & pending, const char * reason)
+{
+  if (pending.attempts >= record_max_attempts_) {
+    pending.status = RecordStatus::FAILED;
+    RCLCPP_ERROR(this->get_logger(), "%s, giving up after %zu attempts: '%s'",
+      reason, pending.attempts, pending.record.topic_name.c_str());
+    return;
+  }
+  RCLCPP_WARN(this->get_logger(), "%s, retrying: '%s'",
+    reason, pending.record.topic_name.c_str());
+  queue_record(pending);
+}
+
+void BbrNode::check_records()
+{
+  auto now = std::chrono::steady_clock::now();
+  RecordRequest record_request;
   {
-    RCLCPP_ERROR(this->get_logger(), "record call failed: '%s'", topic.name.c_str());
-    throw std::runtime_error(
-            "Failed to confirm creation from record service.");
+    std::lock_guard<std::mutex> lock(records_mutex_);
+    for (auto & record_entry : records_) {
+      auto & pending = record_entry.second;
+      if (pending.status == RecordStatus::PENDING && !pending.queued &&
+        now - pending.sent >= record_timeout_)
+      {
+        retry_record(pending, "record call timed out");
+      }
+    }
+
+    if (!service_available_ && !discover_service(now)) {
+      return;
+    }
+
+    if (queued_records_.empty() || now - queued_since_ < record_batch_window_ ||
+      !prepare_record_request(record_request))
+    {
+      return;
+    }
   }
-  auto result = result_future.get();
-  if (not result->success) {
-    RCLCPP_ERROR(this->get_logger(), "record was not created: '%s'", topic.name.c_str());
-    throw std::runtime_error(
-            "Failed to create record from record service.");
+  send_record_request(record_request);
+}
+
+bool BbrNode::discover_service(std::chrono::steady_clock::time_point now)
+{
+  if (records_client_->service_is_ready()) {
+    RCLCPP_INFO(this->get_logger(), "record service available.");
+    service_available_ = true;
+    return true;
   }
+
+  // Recording carries on and records stay queued, so they are still created
+  // and their checkpoints anchored if the service appears later.
+  if (!service_warned_ && now - discovery_start_ >= service_timeout_) {
+    service_warned_ = true;
+    RCLCPP_WARN(this->get_logger(),
+      "record service did not appear, keeping %zu records queued until it does.",
+      queued_records_.size());
+  }
+  return false;
 }
 
 void BbrNode::publish_checkpoint(
   std::shared_ptr<rcutils_uint8_array_t> nonce,
   std::shared_ptr<rcutils_uint8_array_t> hash,
-  std::shared_ptr<const rosbag2_storage::SerializedBagMessage> message)
+  rcutils_time_point_value_t stamp)
 {
-  auto msg = bbr_msgs::msg::CheckpointArray();
-  // msg.stamp = rclcpp::Time(message->time_stamp);
   // FIXME: This time_stamp may be younger than gensius stamp from create_record
-
   auto checkpoint = bbr_msgs::msg::Checkpoint();
   checkpoint.hash.data = std::vector<uint8_t>(
     hash->buffer, hash->buffer + hash->buffer_length);
-  checkpoint.stamp = message->time_stamp;
+  checkpoint.stamp = stamp;
 
-  auto checkpoint_array = bbr_msgs::msg::CheckpointArray();
-  checkpoint_array.checkpoints.push_back(checkpoint);
-  checkpoint_array.uid.data = std::vector<uint8_t>(
-    nonce->buffer, nonce->buffer + nonce->buffer_length);
+  std::string uid(reinterpret_cast<const char *>(nonce->buffer), nonce->buffer_length);
+
+  std::lock_guard<std::mutex> lock(checkpoints_mutex_);
+  auto batch_entry = checkpoint_batches_.find(uid);
+  if (batch_entry == end(checkpoint_batches_)) {
+    CheckpointBatch batch;
+    batch.checkpoint_array.uid.data = std::vector<uint8_t>(
+      nonce->buffer, nonce->buffer + nonce->buffer_length);
+    batch.bytes = 0;
+    batch.started = std::chrono::steady_clock::now();
+    batch_entry = checkpoint_batches_.emplace(uid, std::move(batch)).first;
+  }
+
+  auto & batch = batch_entry->second;
+  batch.bytes += sizeof(checkpoint.stamp) + checkpoint.hash.data.size();
+  batch.checkpoint_array.checkpoints.push_back(std::move(checkpoint));
+
+  if (batch.checkpoint_array.checkpoints.size() >= checkpoint_batch_size_ ||
+    batch.bytes >= checkpoint_batch_bytes_)
+  {
+    RCLCPP_DEBUG(this->get_logger(), "Publishing %zu checkpoints",
+      batch.checkpoint_array.checkpoints.size());
+    checkpoints_publisher_->publish(batch.checkpoint_array);
+    checkpoint_batches_.erase(batch_entry);
+  }
+}
+
+void BbrNode::flush_checkpoints()
+{
+  std::lock_guard<std::mutex> lock(checkpoints_mutex_);
+  for (const auto & batch_entry : checkpoint_batches_) {
+    checkpoints_publisher_->publish(batch_entry.second.checkpoint_array);
+  }
+  checkpoint_batches_.clear();
+}
 
-  RCLCPP_INFO(this->get_logger(), "Publishing checkpoint: '%s'", message->topic_name.c_str());
-  checkpoints_publisher_->publish(checkpoint_array);
+void BbrNode::flush_expired_checkpoints()
+{
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(checkpoints_mutex_);
+  for (auto batch_entry = begin(checkpoint_batches_); batch_entry != end(checkpoint_batches_); ) {
+    if (now - batch_entry->second.started >= checkpoint_linger_) {
+      RCLCPP_DEBUG(this->get_logger(), "Publishing %zu lingering checkpoints",
+        batch_entry->second.checkpoint_array.checkpoints.size());
+      checkpoints_publisher_->publish(batch_entry->second.checkpoint_array);
+      batch_entry = checkpoint_batches_.erase(batch_entry);
+    } else {
+      ++batch_entry;
+    }
+  }
 }
 
 }  // namespace rosbag2_storage_plugins
@@ -0,0 +1,132 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_read_cursor.hpp"
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "rosbag2_storage/storage_interfaces/base_io_interface.hpp"
+#include "rosbag2_storage_default_plugins/sqlite/sqlite_wrapper.hpp"
+
+namespace rosbag2_storage_plugins
+{
+
+BbrReadCursor::BbrReadCursor(
+  const std::string & database_path,
+  const std::string & query,
+  size_t block_size)
+: database_path_(database_path),
+  query_(query),
+  block_size_(block_size > 0 ? block_size : 1),
+  front_index_(0),
+  back_ready_(false),
+  finished_(false),
+  stop_(false)
+{
+  thread_ = std::thread(&BbrReadCursor::run, this);
+}
+
+BbrReadCursor::~BbrReadCursor()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  block_consumed_.notify_all();
+  thread_.join();
+}
+
+bool BbrReadCursor::has_next()
+{
+  if (front_index_ < front_.size()) {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  block_ready_.wait(lock, [this]() {return back_ready_ || finished_;});
+  if (!back_ready_) {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return false;
+  }
+
+  front_.swap(back_);
+  front_index_ = 0;
+  back_.clear();
+  back_ready_ = false;
+  lock.unlock();
+  block_consumed_.notify_one();
+  return !front_.empty();
+}
+
+BbrReadCursor::Row & BbrReadCursor::next()
+{
+  return front_[front_index_++];
+}
+
+bool BbrReadCursor::publish_block(std::vector<Row> & block)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  block_consumed_.wait(lock, [this]() {return !back_ready_ || stop_;});
+  if (stop_) {
+    return false;
+  }
+  back_.swap(block);
+  back_ready_ = true;
+  lock.unlock();
+  block_ready_.notify_one();
+
+  block.clear();
+  block.reserve(block_size_);
+  return true;
+}
+
+void BbrReadCursor::run()
+{
+  try {
+    SqliteWrapper database(
+      database_path_, rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+    auto statement = database.prepare_statement(query_);
+    auto result = statement->execute_query<
+      std::shared_ptr<rcutils_uint8_array_t>, rcutils_time_point_value_t, int>();
+
+    std::vector<Row> block;
+    block.reserve(block_size_);
+    for (auto row : result) {
+      block.push_back({std::get<0>(row), std::get<1>(row), std::get<2>(row)});
+      if (block.size() == block_size_ && !publish_block(block)) {
+        return;
+      }
+    }
+    if (!block.empty() && !publish_block(block)) {
+      return;
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = std::current_exception();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+  }
+  block_ready_.notify_one();
+}
+
+}  // namespace rosbag2_storage_plugins
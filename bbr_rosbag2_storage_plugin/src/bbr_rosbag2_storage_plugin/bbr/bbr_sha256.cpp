@@ -0,0 +1,562 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_sha256.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define BBR_SHA256_X86 1
+# include <cpuid.h>
+# include <immintrin.h>
+#endif
+
+namespace rosbag2_storage_plugins
+{
+
+namespace
+{
+
+const uint32_t K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t INITIAL_STATE[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// Jobs whose inner message is longer than this skip the lanes: copying them
+// into a padded lane buffer would cost more than the lanes save.
+const size_t MAX_LANE_BYTES = 1024;
+const size_t LANES = 8;
+
+using CompressFunction = void (*)(uint32_t * state, const unsigned char * data, size_t blocks);
+using State = std::array<uint32_t, 8>;
+
+inline uint32_t load_be32(const unsigned char * data)
+{
+  return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+         (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+}
+
+inline void store_be32(unsigned char * data, uint32_t value)
+{
+  data[0] = static_cast<unsigned char>(value >> 24);
+  data[1] = static_cast<unsigned char>(value >> 16);
+  data[2] = static_cast<unsigned char>(value >> 8);
+  data[3] = static_cast<unsigned char>(value);
+}
+
+inline uint32_t rotr(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+void compress_scalar(uint32_t * state, const unsigned char * data, size_t blocks)
+{
+  uint32_t w[64];
+  for (; blocks > 0; --blocks, data += SHA256_BLOCK_SIZE) {
+    for (int t = 0; t < 16; ++t) {
+      w[t] = load_be32(data + 4 * t);
+    }
+    for (int t = 16; t < 64; ++t) {
+      uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+      uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+      w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int t = 0; t < 64; ++t) {
+      uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+        K[t] + w[t];
+      uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#ifdef BBR_SHA256_X86
+
+__attribute__((target("sha,sse4.1")))
+void compress_sha_ni(uint32_t * state, const unsigned char * data, size_t blocks)
+{
+  const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  // The SHA instructions keep the state as ABEF and CDGH.
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xb1);
+  __m128i state1 = _mm_shuffle_epi32(
+    _mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1b);
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+  for (; blocks > 0; --blocks, data += SHA256_BLOCK_SIZE) {
+    __m128i abef = state0;
+    __m128i cdgh = state1;
+    __m128i w[4];
+
+    for (int g = 0; g < 16; ++g) {
+      if (g < 4) {
+        w[g] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * g)), byte_swap);
+      } else {
+        w[g % 4] = _mm_sha256msg2_epu32(
+          _mm_add_epi32(
+            _mm_sha256msg1_epu32(w[g % 4], w[(g + 1) % 4]),
+            _mm_alignr_epi8(w[(g + 3) % 4], w[(g + 2) % 4], 4)),
+          w[(g + 3) % 4]);
+      }
+      __m128i message = _mm_add_epi32(
+        w[g % 4], _mm_loadu_si128(reinterpret_cast<const __m128i *>(K + 4 * g)));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0e));
+    }
+
+    state0 = _mm_add_epi32(state0, abef);
+    state1 = _mm_add_epi32(state1, cdgh);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1b);
+  state1 = _mm_shuffle_epi32(state1, 0xb1);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(tmp, state1, 0xf0));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+__attribute__((target("avx2")))
+inline __m256i rotr_x8(__m256i x, int n)
+{
+  return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// Hashes up to eight padded messages in lockstep, one per 32-bit lane.
+// Lanes that run out of blocks keep hashing a zero block, but their state
+// is masked out of the update.
+__attribute__((target("avx2")))
+void compress_avx2_x8(
+  uint32_t (*states)[8], const unsigned char * const * messages, const size_t * blocks,
+  size_t lanes)
+{
+  static const unsigned char zero_block[SHA256_BLOCK_SIZE] = {};
+
+  size_t max_blocks = 0;
+  alignas(32) uint32_t counts[LANES] = {};
+  alignas(32) uint32_t lane_words[LANES];
+  __m256i state[8];
+  for (int i = 0; i < 8; ++i) {
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      lane_words[lane] = lane < lanes ? states[lane][i] : 0;
+    }
+    state[i] = _mm256_load_si256(reinterpret_cast<const __m256i *>(lane_words));
+  }
+  for (size_t lane = 0; lane < lanes; ++lane) {
+    counts[lane] = static_cast<uint32_t>(blocks[lane]);
+    max_blocks = std::max(max_blocks, blocks[lane]);
+  }
+  const __m256i count = _mm256_load_si256(reinterpret_cast<const __m256i *>(counts));
+
+  for (size_t block = 0; block < max_blocks; ++block) {
+    const unsigned char * data[LANES];
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      data[lane] = lane < lanes && block < blocks[lane] ?
+        messages[lane] + block * SHA256_BLOCK_SIZE : zero_block;
+    }
+
+    __m256i w[16];
+    for (int t = 0; t < 16; ++t) {
+      for (size_t lane = 0; lane < LANES; ++lane) {
+        lane_words[lane] = load_be32(data[lane] + 4 * t);
+      }
+      w[t] = _mm256_load_si256(reinterpret_cast<const __m256i *>(lane_words));
+    }
+
+    __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+    __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int t = 0; t < 64; ++t) {
+      if (t >= 16) {
+        __m256i w15 = w[(t - 15) & 15];
+        __m256i w2 = w[(t - 2) & 15];
+        __m256i s0 = _mm256_xor_si256(
+          _mm256_xor_si256(rotr_x8(w15, 7), rotr_x8(w15, 18)), _mm256_srli_epi32(w15, 3));
+        __m256i s1 = _mm256_xor_si256(
+          _mm256_xor_si256(rotr_x8(w2, 17), rotr_x8(w2, 19)), _mm256_srli_epi32(w2, 10));
+        w[t & 15] = _mm256_add_epi32(
+          _mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+      }
+      __m256i sigma1 = _mm256_xor_si256(
+        _mm256_xor_si256(rotr_x8(e, 6), rotr_x8(e, 11)), rotr_x8(e, 25));
+      __m256i choice = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+      __m256i t1 = _mm256_add_epi32(
+        _mm256_add_epi32(h, sigma1),
+        _mm256_add_epi32(
+          choice, _mm256_add_epi32(w[t & 15], _mm256_set1_epi32(static_cast<int>(K[t])))));
+      __m256i sigma0 = _mm256_xor_si256(
+        _mm256_xor_si256(rotr_x8(a, 2), rotr_x8(a, 13)), rotr_x8(a, 22));
+      __m256i majority = _mm256_xor_si256(
+        _mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(a, c)),
+        _mm256_and_si256(b, c));
+      __m256i t2 = _mm256_add_epi32(sigma0, majority);
+      h = g;
+      g = f;
+      f = e;
+      e = _mm256_add_epi32(d, t1);
+      d = c;
+      c = b;
+      b = a;
+      a = _mm256_add_epi32(t1, t2);
+    }
+
+    const __m256i active = _mm256_cmpgt_epi32(
+      count, _mm256_set1_epi32(static_cast<int>(block)));
+    const __m256i updated[8] = {a, b, c, d, e, f, g, h};
+    for (int i = 0; i < 8; ++i) {
+      state[i] = _mm256_blendv_epi8(
+        state[i], _mm256_add_epi32(state[i], updated[i]), active);
+    }
+  }
+
+  for (int i = 0; i < 8; ++i) {
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lane_words), state[i]);
+    for (size_t lane = 0; lane < lanes; ++lane) {
+      states[lane][i] = lane_words[lane];
+    }
+  }
+}
+
+#endif  // BBR_SHA256_X86
+
+CompressFunction single_stream_compress(Sha256Backend backend)
+{
+#ifdef BBR_SHA256_X86
+  // Jobs too large for the lanes still get the SHA extensions if present.
+  static const bool sha_ni = isSha256BackendSupported(Sha256Backend::SHA_NI);
+  if (backend == Sha256Backend::SHA_NI || (backend == Sha256Backend::AVX2 && sha_ni)) {
+    return compress_sha_ni;
+  }
+#else
+  (void)backend;
+#endif
+  return compress_scalar;
+}
+
+void make_pads(
+  const HmacSha256Job & job, Sha256Backend backend,
+  unsigned char * ipad, unsigned char * opad)
+{
+  unsigned char key_block[SHA256_BLOCK_SIZE] = {};
+  if (job.key_length > SHA256_BLOCK_SIZE) {
+    BbrSha256Hasher key_hash(backend);
+    key_hash.update(job.key, job.key_length);
+    key_hash.finalize(key_block);
+  } else {
+    std::memcpy(key_block, job.key, job.key_length);
+  }
+  for (size_t i = 0; i < SHA256_BLOCK_SIZE; ++i) {
+    ipad[i] = key_block[i] ^ 0x36;
+    opad[i] = key_block[i] ^ 0x5c;
+  }
+}
+
+void hmac_single(const HmacSha256Job & job, Sha256Backend backend)
+{
+  unsigned char ipad[SHA256_BLOCK_SIZE];
+  unsigned char opad[SHA256_BLOCK_SIZE];
+  make_pads(job, backend, ipad, opad);
+
+  unsigned char inner[SHA256_DIGEST_SIZE];
+  BbrSha256Hasher inner_hash(backend);
+  inner_hash.update(ipad, SHA256_BLOCK_SIZE);
+  inner_hash.update(job.header, job.header_size);
+  inner_hash.update(job.data, job.data_length);
+  inner_hash.finalize(inner);
+
+  BbrSha256Hasher outer_hash(backend);
+  outer_hash.update(opad, SHA256_BLOCK_SIZE);
+  outer_hash.update(inner, SHA256_DIGEST_SIZE);
+  outer_hash.finalize(job.digest);
+}
+
+#ifdef BBR_SHA256_X86
+
+// Appends pad || header || data with SHA-256 padding and returns the
+// number of blocks written.
+size_t append_padded(
+  std::vector<unsigned char> & arena, const unsigned char * pad,
+  const void * header, size_t header_size, const void * data, size_t data_length)
+{
+  size_t length = SHA256_BLOCK_SIZE + header_size + data_length;
+  size_t blocks = (length + 8) / SHA256_BLOCK_SIZE + 1;
+  size_t offset = arena.size();
+  arena.resize(offset + blocks * SHA256_BLOCK_SIZE, 0);
+
+  unsigned char * out = arena.data() + offset;
+  std::memcpy(out, pad, SHA256_BLOCK_SIZE);
+  if (header_size > 0) {
+    std::memcpy(out + SHA256_BLOCK_SIZE, header, header_size);
+  }
+  if (data_length > 0) {
+    std::memcpy(out + SHA256_BLOCK_SIZE + header_size, data, data_length);
+  }
+  out[length] = 0x80;
+  uint64_t bits = static_cast<uint64_t>(length) * 8;
+  for (int i = 0; i < 8; ++i) {
+    out[blocks * SHA256_BLOCK_SIZE - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+  }
+  return blocks;
+}
+
+// Runs every padded message through the lanes, eight at a time, with
+// messages of similar length grouped so few lanes idle.
+void hash_lanes(
+  const std::vector<unsigned char> & arena, const std::vector<size_t> & offsets,
+  const std::vector<size_t> & blocks, std::vector<size_t> & order,
+  std::vector<State> & states)
+{
+  std::sort(order.begin(), order.end(), [&blocks](size_t a, size_t b) {
+      return blocks[a] < blocks[b];
+    });
+
+  for (size_t first = 0; first < order.size(); first += LANES) {
+    size_t lanes = std::min(LANES, order.size() - first);
+    uint32_t lane_states[LANES][8];
+    const unsigned char * messages[LANES];
+    size_t lane_blocks[LANES];
+    for (size_t lane = 0; lane < lanes; ++lane) {
+      size_t job = order[first + lane];
+      std::memcpy(lane_states[lane], INITIAL_STATE, sizeof(INITIAL_STATE));
+      messages[lane] = arena.data() + offsets[job];
+      lane_blocks[lane] = blocks[job];
+    }
+    compress_avx2_x8(lane_states, messages, lane_blocks, lanes);
+    for (size_t lane = 0; lane < lanes; ++lane) {
+      std::memcpy(states[order[first + lane]].data(), lane_states[lane], sizeof(lane_states[lane]));
+    }
+  }
+}
+
+void hmac_lanes(HmacSha256Job * jobs, size_t count)
+{
+  thread_local std::vector<unsigned char> inner_arena;
+  thread_local std::vector<unsigned char> outer_arena;
+  std::vector<size_t> lane_jobs;
+  std::vector<size_t> inner_offsets;
+  std::vector<size_t> inner_blocks;
+  std::vector<size_t> outer_offsets;
+  std::vector<size_t> outer_blocks;
+  std::vector<unsigned char> opads;
+  inner_arena.clear();
+  outer_arena.clear();
+
+  for (size_t i = 0; i < count; ++i) {
+    if (jobs[i].header_size + jobs[i].data_length > MAX_LANE_BYTES) {
+      hmac_single(jobs[i], Sha256Backend::AVX2);
+      continue;
+    }
+    unsigned char ipad[SHA256_BLOCK_SIZE];
+    size_t opad_offset = opads.size();
+    opads.resize(opad_offset + SHA256_BLOCK_SIZE);
+    make_pads(jobs[i], Sha256Backend::AVX2, ipad, opads.data() + opad_offset);
+
+    lane_jobs.push_back(i);
+    inner_offsets.push_back(inner_arena.size());
+    inner_blocks.push_back(append_padded(inner_arena, ipad,
+      jobs[i].header, jobs[i].header_size, jobs[i].data, jobs[i].data_length));
+  }
+  if (lane_jobs.empty()) {
+    return;
+  }
+
+  std::vector<size_t> order(lane_jobs.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::vector<State> states(lane_jobs.size());
+  hash_lanes(inner_arena, inner_offsets, inner_blocks, order, states);
+
+  // Every outer message is opad || inner digest, exactly two blocks.
+  for (size_t i = 0; i < lane_jobs.size(); ++i) {
+    unsigned char inner[SHA256_DIGEST_SIZE];
+    for (int word = 0; word < 8; ++word) {
+      store_be32(inner + 4 * word, states[i][word]);
+    }
+    outer_offsets.push_back(outer_arena.size());
+    outer_blocks.push_back(append_padded(outer_arena, opads.data() + i * SHA256_BLOCK_SIZE,
+      nullptr, 0, inner, SHA256_DIGEST_SIZE));
+  }
+  hash_lanes(outer_arena, outer_offsets, outer_blocks, order, states);
+
+  for (size_t i = 0; i < lane_jobs.size(); ++i) {
+    for (int word = 0; word < 8; ++word) {
+      store_be32(jobs[lane_jobs[i]].digest + 4 * word, states[i][word]);
+    }
+  }
+}
+
+#endif  // BBR_SHA256_X86
+
+}  // namespace
+
+bool isSha256BackendSupported(Sha256Backend backend)
+{
+  if (backend == Sha256Backend::SCALAR) {
+    return true;
+  }
+#ifdef BBR_SHA256_X86
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  bool ssse3 = (ecx & bit_SSSE3) != 0;
+  bool sse41 = (ecx & bit_SSE4_1) != 0;
+  bool osxsave = (ecx & bit_OSXSAVE) != 0;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+
+  if (backend == Sha256Backend::SHA_NI) {
+    return ssse3 && sse41 && (ebx & bit_SHA) != 0;
+  }
+  if (backend == Sha256Backend::AVX2) {
+    if (!osxsave || (ebx & bit_AVX2) == 0) {
+      return false;
+    }
+    // The OS has to save the YMM registers across context switches.
+    unsigned int xcr0_low, xcr0_high;
+    __asm__ ("xgetbv" : "=a" (xcr0_low), "=d" (xcr0_high) : "c" (0));
+    return (xcr0_low & 0x6) == 0x6;
+  }
+#endif
+  return false;
+}
+
+Sha256Backend detectSha256Backend()
+{
+  if (isSha256BackendSupported(Sha256Backend::SHA_NI)) {
+    return Sha256Backend::SHA_NI;
+  }
+  if (isSha256BackendSupported(Sha256Backend::AVX2)) {
+    return Sha256Backend::AVX2;
+  }
+  return Sha256Backend::SCALAR;
+}
+
+const char * getSha256BackendName(Sha256Backend backend)
+{
+  switch (backend) {
+    case Sha256Backend::SHA_NI:
+      return "sha_ni";
+    case Sha256Backend::AVX2:
+      return "avx2";
+    case Sha256Backend::SCALAR:
+      break;
+  }
+  return "scalar";
+}
+
+void computeHmacSha256(HmacSha256Job * jobs, size_t count, Sha256Backend backend)
+{
+#ifdef BBR_SHA256_X86
+  if (backend == Sha256Backend::AVX2 && count > 1) {
+    hmac_lanes(jobs, count);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count; ++i) {
+    hmac_single(jobs[i], backend);
+  }
+}
+
+BbrSha256Hasher::BbrSha256Hasher(Sha256Backend backend)
+: compress_(single_stream_compress(backend))
+{
+  init();
+}
+
+void BbrSha256Hasher::init()
+{
+  std::memcpy(state_, INITIAL_STATE, sizeof(state_));
+  buffered_ = 0;
+  length_ = 0;
+}
+
+void BbrSha256Hasher::update(const void * data, size_t length)
+{
+  if (length == 0) {
+    return;
+  }
+  auto bytes = static_cast<const unsigned char *>(data);
+  length_ += length;
+  if (buffered_ > 0) {
+    size_t take = std::min(length, SHA256_BLOCK_SIZE - buffered_);
+    std::memcpy(buffer_ + buffered_, bytes, take);
+    buffered_ += take;
+    bytes += take;
+    length -= take;
+    if (buffered_ < SHA256_BLOCK_SIZE) {
+      return;
+    }
+    compress_(state_, buffer_, 1);
+    buffered_ = 0;
+  }
+  size_t blocks = length / SHA256_BLOCK_SIZE;
+  if (blocks > 0) {
+    compress_(state_, bytes, blocks);
+    bytes += blocks * SHA256_BLOCK_SIZE;
+    length -= blocks * SHA256_BLOCK_SIZE;
+  }
+  if (length > 0) {
+    std::memcpy(buffer_, bytes, length);
+  }
+  buffered_ = length;
+}
+
+void BbrSha256Hasher::finalize(unsigned char * out)
+{
+  uint64_t bits = length_ * 8;
+  unsigned char padding[SHA256_BLOCK_SIZE * 2] = {0x80};
+  size_t padding_size = (buffered_ < 56 ? 56 : 120) - buffered_;
+  for (int i = 0; i < 8; ++i) {
+    padding[padding_size + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+  }
+  update(padding, padding_size + 8);
+  for (int i = 0; i < 8; ++i) {
+    store_be32(out + 4 * i, state_[i]);
+  }
+}
+
+}  // namespace rosbag2_storage_plugins
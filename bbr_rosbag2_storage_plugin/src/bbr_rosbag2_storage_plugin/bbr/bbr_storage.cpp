@@ -17,7 +17,9 @@
 
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cinttypes>
 #include <cstring>
 #include <iostream>
 #include <fstream>
@@ -28,6 +30,7 @@
 
 #include "rosbag2_storage/filesystem_helper.hpp"
 #include "rosbag2_storage/metadata_io.hpp"
+#include "rosbag2_storage/ros_helper.hpp"
 #include "rosbag2_storage/serialized_bag_message.hpp"
 #include "rosbag2_storage_default_plugins/sqlite/sqlite_statement_wrapper.hpp"
 #include "rosbag2_storage_default_plugins/sqlite/sqlite_exception.hpp"
@@ -37,18 +40,58 @@
 namespace rosbag2_storage_plugins
 {
 
+namespace
+{
+
+// Limits on how far get_bag_size may run on estimated bytes while recording.
+const uint64_t SIZE_SAMPLE_BYTES = 1024 * 1024;
+const std::chrono::milliseconds SIZE_SAMPLE_PERIOD(1000);
+
+}  // namespace
+
 BbrStorage::BbrStorage()
 : node_(),
   helper_(),
   database_(),
   write_statement_(nullptr),
-  read_statement_(nullptr),
-  message_result_(nullptr),
-  current_message_row_(nullptr, SqliteStatementWrapper::QueryResult<>::Iterator::POSITION_END)
+  chain_segment_size_(0),
+  checkpoint_merkle_(false),
+  checkpoint_period_(0),
+  stop_checkpoint_timer_(false),
+  group_commit_messages_(0),
+  group_commit_period_(0),
+  in_transaction_(false),
+  transaction_messages_(0),
+  database_size_(0),
+  unsampled_bytes_(0),
+  async_write_(false),
+  overflow_policy_(OverflowPolicy::BLOCK),
+  writer_sleeping_(false),
+  stop_writer_(false),
+  max_queue_depth_(0),
+  dropped_messages_(0)
 {
-  node_ = std::make_shared<BbrNode>("rosbag2_bbr");
   helper_ = std::make_shared<BbrHelper>();
-  nonce_ = helper_->createNonce();
+}
+
+BbrStorage::~BbrStorage()
+{
+  stop_writer();
+  stop_checkpoint_timer();
+  try {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (node_) {
+      close_open_segments();
+      anchor_unanchored_topics();
+      commit_transaction();
+      node_->flush_checkpoints();
+      create_indexes();
+      write_topic_summaries();
+    }
+  } catch (const std::exception & e) {
+    ROSBAG2_STORAGE_DEFAULT_PLUGINS_LOG_ERROR(
+      "Failed to commit pending messages on close: %s", e.what());
+  }
 }
 
 void BbrStorage::open(
@@ -73,18 +116,24 @@ void BbrStorage::open(
     database_name_ = rosbag2_storage::FilesystemHelper::get_folder_name(uri) + ".db3";
   }
 
-  std::string database_path = rosbag2_storage::FilesystemHelper::concat({uri, database_name_});
-  if (is_read_only(io_flag) && !database_exists(database_path)) {
+  database_path_ = rosbag2_storage::FilesystemHelper::concat({uri, database_name_});
+  if (is_read_only(io_flag) && !database_exists(database_path_)) {
     throw std::runtime_error(
             "Failed to read from bag '" + uri + "': File '" + database_name_ + "' does not exist.");
   }
 
   try {
-    database_ = std::make_unique<SqliteWrapper>(database_path, io_flag);
+    database_ = std::make_unique<SqliteWrapper>(database_path_, io_flag);
   } catch (const SqliteException & e) {
     throw std::runtime_error("Failed to setup storage. Error: " + std::string(e.what()));
   }
 
+  // Only recording talks to the ledger; reading and metadata stay offline.
+  if (!is_read_only(io_flag)) {
+    node_ = std::make_shared<BbrNode>("rosbag2_bbr");
+    nonce_ = helper_->createNonce();
+  }
+
   if (!metadata) {
     initialize();
   }
@@ -97,40 +146,291 @@ void BbrStorage::write(std::shared_ptr<const rosbag2_storage::SerializedBagMessa
   if (!write_statement_) {
     prepare_for_writing();
   }
+
+  if (async_write_) {
+    // Reject unknown topics here as the synchronous path does; once queued,
+    // a bad message would otherwise only surface on the writer thread.
+    if (topics_.find(message->topic_name) == end(topics_)) {
+      throw SqliteException("Topic '" + message->topic_name +
+              "' has not been created yet! Call 'create_topic' first.");
+    }
+    enqueue(message);
+  } else {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    write_message(message);
+  }
+}
+
+void BbrStorage::write_message(
+  std::shared_ptr<const rosbag2_storage::SerializedBagMessage> message,
+  std::shared_ptr<rcutils_uint8_array_t> digest)
+{
   auto topic_entry = topics_.find(message->topic_name);
   if (topic_entry == end(topics_)) {
     throw SqliteException("Topic '" + message->topic_name +
             "' has not been created yet! Call 'create_topic' first.");
   }
 
-  topic_entry->second.digest = helper_->computeMessageDigest(topic_entry->second.digest, message);
-  write_statement_->bind(message->time_stamp, topic_entry->second.id, message->serialized_data,
-    topic_entry->second.digest);
+  if (group_commit_messages_ > 1 && !in_transaction_) {
+    begin_transaction();
+  }
+
+  auto & topic_info = topic_entry->second;
+  if (digest) {
+    topic_info.digest = digest;
+  } else {
+    if (topic_info.segment_size > 0 && topic_info.segment_messages == 0) {
+      topic_info.digest = helper_->computeSegmentKey(*topic_info.nonce, topic_info.segment_index);
+    }
+    topic_info.digest = helper_->computeMessageDigest(
+      *topic_info.digest, message->time_stamp, *message->serialized_data);
+  }
+  write_statement_->bind(message->time_stamp, topic_info.id, message->serialized_data,
+    topic_info.digest);
   write_statement_->execute_and_reset();
-  node_->publish_checkpoint(topic_entry->second.nonce, topic_entry->second.digest, message);
+  auto row_id = static_cast<rcutils_time_point_value_t>(database_->get_last_insert_id());
+  if (topic_info.segment_size > 0) {
+    if (topic_info.segment_messages++ == 0) {
+      topic_info.segment_first_id = row_id;
+    }
+    topic_info.segment_last_id = row_id;
+  }
+  if (topic_info.merkle) {
+    if (topic_info.merkle->size() == 0) {
+      topic_info.merkle_first_id = row_id;
+    }
+    topic_info.merkle_last_id = row_id;
+    topic_info.merkle->append(topic_info.digest->buffer, topic_info.digest->buffer_length);
+  }
+
+  topic_info.last_stamp = message->time_stamp;
+  auto & summary = topic_info.summary;
+  if (summary.message_count == 0 || message->time_stamp < summary.min_stamp) {
+    summary.min_stamp = message->time_stamp;
+  }
+  if (summary.message_count == 0 || message->time_stamp > summary.max_stamp) {
+    summary.max_stamp = message->time_stamp;
+  }
+  summary.message_count += 1;
+  auto row_bytes = message->serialized_data->buffer_length + topic_info.digest->buffer_length;
+  summary.bytes += row_bytes;
+  unsampled_bytes_ += row_bytes;
+  topic_info.checkpoint.messages += 1;
+  topic_info.checkpoint.bytes += message->serialized_data->buffer_length;
+  auto now = std::chrono::steady_clock::now();
+  if (checkpoint_policy_->should_checkpoint(topic_info.checkpoint, now)) {
+    anchor_checkpoint(topic_info, now);
+  }
+
+  if (topic_info.segment_size > 0 && topic_info.segment_messages == topic_info.segment_size) {
+    close_segment(topic_info);
+  }
+
+  if (in_transaction_) {
+    ++transaction_messages_;
+    if (transaction_messages_ >= group_commit_messages_ ||
+      now - transaction_start_ >= group_commit_period_)
+    {
+      commit_transaction();
+    }
+  }
+
+  // unsampled_bytes_ misses row, page and index overhead, so the estimate is
+  // re-anchored to the file size regularly whether or not commits are grouped.
+  if (unsampled_bytes_ >= SIZE_SAMPLE_BYTES || now - size_sampled_ >= SIZE_SAMPLE_PERIOD) {
+    sample_database_size();
+  }
+}
+
+void BbrStorage::write_messages(
+  const std::vector<std::shared_ptr<const rosbag2_storage::SerializedBagMessage>> & messages)
+{
+  // Chains of different topics are independent, so the n-th pending message
+  // of every topic is hashed in one batch while each chain still advances
+  // in order. Rows are then inserted in arrival order as before.
+  struct Chain
+  {
+    TopicInfo * topic_info;
+    std::shared_ptr<rcutils_uint8_array_t> key;
+    size_t pending;
+  };
+  std::unordered_map<std::string, Chain> chains;
+  std::vector<Chain *> message_chains(messages.size(), nullptr);
+  std::vector<std::vector<size_t>> waves;
+  for (size_t i = 0; i < messages.size(); ++i) {
+    auto topic_entry = topics_.find(messages[i]->topic_name);
+    if (topic_entry == end(topics_)) {
+      continue;
+    }
+    auto & chain = chains.emplace(
+      messages[i]->topic_name, Chain{&topic_entry->second, topic_entry->second.digest, 0})
+      .first->second;
+    message_chains[i] = &chain;
+    if (waves.size() <= chain.pending) {
+      waves.resize(chain.pending + 1);
+    }
+    waves[chain.pending++].push_back(i);
+  }
+
+  std::vector<std::shared_ptr<rcutils_uint8_array_t>> digests(messages.size());
+  std::vector<MessageDigestJob> jobs;
+  for (size_t wave = 0; wave < waves.size(); ++wave) {
+    jobs.clear();
+    for (auto i : waves[wave]) {
+      auto & chain = *message_chains[i];
+      const auto & topic_info = *chain.topic_info;
+      if (topic_info.segment_size > 0) {
+        size_t segment_position = topic_info.segment_messages + wave;
+        if (segment_position % topic_info.segment_size == 0) {
+          chain.key = helper_->computeSegmentKey(*topic_info.nonce,
+              topic_info.segment_index + segment_position / topic_info.segment_size);
+        }
+      }
+      jobs.push_back(
+        {chain.key.get(), messages[i]->time_stamp, messages[i]->serialized_data.get(), nullptr});
+    }
+    helper_->computeMessageDigests(jobs);
+    for (size_t j = 0; j < jobs.size(); ++j) {
+      auto i = waves[wave][j];
+      digests[i] = jobs[j].digest;
+      message_chains[i]->key = jobs[j].digest;
+    }
+  }
+
+  for (size_t i = 0; i < messages.size(); ++i) {
+    if (!message_chains[i]) {
+      // A single bad message must not stop the writer for every topic.
+      ROSBAG2_STORAGE_DEFAULT_PLUGINS_LOG_ERROR(
+        "Dropped message for unknown topic '%s'.", messages[i]->topic_name.c_str());
+      continue;
+    }
+    write_message(messages[i], digests[i]);
+  }
+}
+
+void BbrStorage::anchor_checkpoint(
+  TopicInfo & topic_info, std::chrono::steady_clock::time_point now)
+{
+  auto anchored = topic_info.digest;
+  if (topic_info.merkle && topic_info.merkle->size() > 0) {
+    anchored = close_merkle_window(topic_info);
+  }
+
+  if (in_transaction_) {
+    pending_checkpoints_.push_back({topic_info.nonce, anchored, topic_info.last_stamp});
+  } else {
+    node_->publish_checkpoint(topic_info.nonce, anchored, topic_info.last_stamp);
+  }
+  topic_info.checkpoint.messages = 0;
+  topic_info.checkpoint.bytes = 0;
+  topic_info.checkpoint.last_checkpoint = now;
+}
+
+void BbrStorage::anchor_unanchored_topics()
+{
+  auto now = std::chrono::steady_clock::now();
+  for (auto & topic_entry : topics_) {
+    if (topic_entry.second.checkpoint.messages > 0) {
+      anchor_checkpoint(topic_entry.second, now);
+    }
+  }
+}
+
+std::shared_ptr<rcutils_uint8_array_t> BbrStorage::close_merkle_window(TopicInfo & topic_info)
+{
+  // The window's leaves are the digests already stored in messages, so only
+  // the root and the id range are kept to rebuild proofs later.
+  auto root = topic_info.merkle->root();
+  auto root_message = rosbag2_storage::make_serialized_message(root.data(), root.size());
+
+  auto insert_root = database_->prepare_statement(
+    "INSERT INTO merkle_roots "
+    "(topic_id, window_index, first_id, last_id, leaf_count, root) "
+    "VALUES (?, ?, ?, ?, ?, ?);");
+  insert_root->bind(topic_info.id,
+    static_cast<rcutils_time_point_value_t>(topic_info.merkle_window),
+    topic_info.merkle_first_id,
+    topic_info.merkle_last_id,
+    static_cast<int>(topic_info.merkle->size()),
+    root_message);
+  insert_root->execute_and_reset();
+
+  topic_info.merkle->reset();
+  topic_info.merkle_window += 1;
+  return root_message;
+}
+
+void BbrStorage::close_segment(TopicInfo & topic_info)
+{
+  // The segment's last digest is its root. Roots are chained through links
+  // starting at the topic digest, and every link is anchored so that no
+  // closed segment can be replaced without breaking the ledger.
+  auto root = topic_info.digest;
+  topic_info.segment_link =
+    helper_->computeSegmentLink(*topic_info.segment_link, topic_info.segment_index, *root);
+
+  auto insert_segment = database_->prepare_statement(
+    "INSERT INTO segments "
+    "(topic_id, segment_index, first_id, last_id, message_count, root, link) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?);");
+  insert_segment->bind(topic_info.id,
+    static_cast<rcutils_time_point_value_t>(topic_info.segment_index),
+    topic_info.segment_first_id,
+    topic_info.segment_last_id,
+    static_cast<int>(topic_info.segment_messages),
+    root, topic_info.segment_link);
+  insert_segment->execute_and_reset();
+
+  if (in_transaction_) {
+    pending_checkpoints_.push_back(
+      {topic_info.nonce, topic_info.segment_link, topic_info.last_stamp});
+  } else {
+    node_->publish_checkpoint(topic_info.nonce, topic_info.segment_link, topic_info.last_stamp);
+  }
+
+  topic_info.segment_index += 1;
+  topic_info.segment_messages = 0;
+}
+
+void BbrStorage::close_open_segments()
+{
+  for (auto & topic_entry : topics_) {
+    if (topic_entry.second.segment_messages > 0) {
+      close_segment(topic_entry.second);
+    }
+  }
 }
 
 bool BbrStorage::has_next()
 {
-  if (!read_statement_) {
+  if (!read_cursor_) {
     prepare_for_reading();
   }
 
-  return current_message_row_ != message_result_.end();
+  return read_cursor_->has_next();
 }
 
 std::shared_ptr<rosbag2_storage::SerializedBagMessage> BbrStorage::read_next()
 {
-  if (!read_statement_) {
+  if (!read_cursor_) {
     prepare_for_reading();
   }
 
-  auto bag_message = std::make_shared<rosbag2_storage::SerializedBagMessage>();
-  bag_message->serialized_data = std::get<0>(*current_message_row_);
-  bag_message->time_stamp = std::get<1>(*current_message_row_);
-  bag_message->topic_name = std::get<2>(*current_message_row_);
+  if (!read_cursor_->has_next()) {
+    throw std::runtime_error("No more messages to read.");
+  }
+  auto & row = read_cursor_->next();
+
+  auto topic_name = topic_names_.find(row.topic_id);
+  if (topic_name == topic_names_.end()) {
+    throw SqliteException(
+            "Message references unknown topic id " + std::to_string(row.topic_id) + ".");
+  }
 
-  ++current_message_row_;
+  auto bag_message = std::make_shared<rosbag2_storage::SerializedBagMessage>();
+  bag_message->serialized_data = std::move(row.data);
+  bag_message->time_stamp = row.timestamp;
+  bag_message->topic_name = topic_name->second;
   return bag_message;
 }
 
@@ -145,13 +445,25 @@ std::vector<rosbag2_storage::TopicMetadata> BbrStorage::get_all_topics_and_types
 
 void BbrStorage::initialize()
 {
+  auto profile = node_->get_parameter("recording_profile").as_string();
+  if (profile != "default" && profile != "bulk_load") {
+    throw std::runtime_error("Unknown recording_profile '" + profile + "'.");
+  }
+  bool bulk_load = profile == "bulk_load";
+  if (bulk_load) {
+    apply_bulk_load_pragmas();
+  }
+
   std::string create_stmt = "CREATE TABLE topics(" \
     "id INTEGER PRIMARY KEY," \
     "name TEXT NOT NULL," \
     "type TEXT NOT NULL," \
     "serialization_format TEXT NOT NULL,"
     "bbr_nonce BLOB NOT NULL,"
-    "bbr_digest BLOB NOT NULL);";
+    "bbr_digest BLOB NOT NULL,"
+    "bbr_format INTEGER NOT NULL DEFAULT 0,"
+    "bbr_segment_size INTEGER NOT NULL DEFAULT 0,"
+    "bbr_digest_algorithm INTEGER NOT NULL DEFAULT 0);";
   database_->prepare_statement(create_stmt)->execute_and_reset();
   create_stmt = "CREATE TABLE messages(" \
     "id INTEGER PRIMARY KEY," \
@@ -160,59 +472,465 @@ void BbrStorage::initialize()
     "data BLOB NOT NULL,"
     "bbr_digest BLOB NOT NULL);";
   database_->prepare_statement(create_stmt)->execute_and_reset();
-  create_stmt = "CREATE INDEX timestamp_idx ON messages (timestamp ASC);";
+  create_stmt = "CREATE TABLE segments(" \
+    "topic_id INTEGER NOT NULL," \
+    "segment_index INTEGER NOT NULL," \
+    "first_id INTEGER NOT NULL," \
+    "last_id INTEGER NOT NULL," \
+    "message_count INTEGER NOT NULL," \
+    "root BLOB NOT NULL," \
+    "link BLOB NOT NULL," \
+    "PRIMARY KEY (topic_id, segment_index));";
+  database_->prepare_statement(create_stmt)->execute_and_reset();
+  create_stmt = "CREATE TABLE merkle_roots(" \
+    "topic_id INTEGER NOT NULL," \
+    "window_index INTEGER NOT NULL," \
+    "first_id INTEGER NOT NULL," \
+    "last_id INTEGER NOT NULL," \
+    "leaf_count INTEGER NOT NULL," \
+    "root BLOB NOT NULL," \
+    "PRIMARY KEY (topic_id, window_index));";
   database_->prepare_statement(create_stmt)->execute_and_reset();
+  chain_segment_size_ = static_cast<size_t>(
+    node_->get_parameter("chain_segment_size").as_int());
+  checkpoint_merkle_ = node_->get_parameter("checkpoint_merkle").as_bool();
+  helper_->setDigestAlgorithm(
+    parseDigestAlgorithm(node_->get_parameter("digest_algorithm").as_string()));
+
+  // Bulk loads build the index once at close instead of on every insert.
+  if (!bulk_load) {
+    create_stmt = "CREATE INDEX timestamp_idx ON messages (timestamp ASC);";
+    database_->prepare_statement(create_stmt)->execute_and_reset();
+  }
+}
+
+void BbrStorage::apply_bulk_load_pragmas()
+{
+  // The page size only applies while the database is empty and before it
+  // is switched to WAL, so it has to come first.
+  auto page_size = node_->get_parameter("sqlite_page_size").as_int();
+  database_->prepare_statement(
+    "PRAGMA page_size = " + std::to_string(page_size) + ";")->execute_and_reset();
+  auto cache_size = node_->get_parameter("sqlite_cache_size_kb").as_int();
+  database_->prepare_statement(
+    "PRAGMA cache_size = -" + std::to_string(cache_size) + ";")->execute_and_reset();
+
+  auto journal_mode = database_->prepare_statement("PRAGMA journal_mode = WAL;");
+  auto query_results = journal_mode->execute_query<std::string>();
+  for (auto result : query_results) {
+    if (std::get<0>(result) != "wal") {
+      ROSBAG2_STORAGE_DEFAULT_PLUGINS_LOG_WARN(
+        "Failed to enable WAL journal, using '%s'.", std::get<0>(result).c_str());
+    }
+  }
+  database_->prepare_statement("PRAGMA synchronous = NORMAL;")->execute_and_reset();
 }
 
 void BbrStorage::create_topic(const rosbag2_storage::TopicMetadata & topic)
 {
+  std::lock_guard<std::mutex> lock(write_mutex_);
   if (topics_.find(topic.name) == std::end(topics_)) {
+    // A record is announced to the ledger right away, so its row must not
+    // sit behind uncommitted messages.
+    commit_transaction();
     auto insert_topic = database_->prepare_statement(
-      "INSERT INTO topics (name, type, serialization_format, bbr_nonce, bbr_digest) VALUES (?, ?, ?, ?, ?)");
+      "INSERT INTO topics (name, type, serialization_format, bbr_nonce, bbr_digest, bbr_format, "
+      "bbr_segment_size, bbr_digest_algorithm) VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
 
     auto bbr_nonce = nonce_;
     auto bbr_digest = helper_->computeTopicDigest(bbr_nonce, topic);
     nonce_ = helper_->computeTopicNonce(bbr_digest, topic);
 
-    insert_topic->bind(topic.name, topic.type, topic.serialization_format, bbr_nonce, bbr_digest);
+    insert_topic->bind(topic.name, topic.type, topic.serialization_format, bbr_nonce, bbr_digest,
+      static_cast<int>(helper_->getMessageFormat()), static_cast<int>(chain_segment_size_),
+      static_cast<int>(helper_->getDigestAlgorithm()));
     insert_topic->execute_and_reset();
     BbrStorage::TopicInfo topic_info;
     topic_info.id = static_cast<int>(database_->get_last_insert_id());
     topic_info.digest = bbr_digest;
     topic_info.nonce = bbr_digest;
+    topic_info.last_stamp = 0;
+    topic_info.checkpoint = {0, 0, std::chrono::steady_clock::now()};
+    topic_info.summary = {topic, 0, 0, 0, 0};
+    topic_info.segment_size = chain_segment_size_;
+    topic_info.segment_index = 0;
+    topic_info.segment_messages = 0;
+    topic_info.segment_first_id = 0;
+    topic_info.segment_last_id = 0;
+    topic_info.segment_link = bbr_digest;
+    if (checkpoint_merkle_) {
+      topic_info.merkle = std::make_unique<BbrMerkleAccumulator>();
+    }
+    topic_info.merkle_window = 0;
+    topic_info.merkle_first_id = 0;
+    topic_info.merkle_last_id = 0;
     node_->create_record(bbr_digest, topic);
-    topics_.emplace(topic.name, topic_info);
+    topics_.emplace(topic.name, std::move(topic_info));
   }
 }
 
 void BbrStorage::remove_topic(const rosbag2_storage::TopicMetadata & topic)
 {
-  // TODO: How should this class interface be handeled with DLT transactions?
-  // if (topics_.find(topic.name) != std::end(topics_)) {
-  //   auto delete_topic =
-  //     database_->prepare_statement(
-  //     "DELETE FROM topics where name = ? and type = ? and serialization_format = ?");
-  //   delete_topic->bind(topic.name, topic.type, topic.serialization_format);
-  //   delete_topic->execute_and_reset();
-  //   topics_.erase(topic.name);
-  // }
+  // A record on the ledger cannot be deleted, so the topic and its rows are
+  // kept and late messages still extend its chain. Its unanchored tail is
+  // anchored now instead of waiting for the storage to close.
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  if (writer_thread_.joinable()) {
+    queue_drained_.wait(lock, [this]() {return queue_->empty() || stop_writer_;});
+  }
+  auto topic_entry = topics_.find(topic.name);
+  if (topic_entry == end(topics_)) {
+    return;
+  }
+
+  auto & topic_info = topic_entry->second;
+  if (topic_info.segment_messages > 0) {
+    close_segment(topic_info);
+  }
+  if (topic_info.checkpoint.messages > 0) {
+    anchor_checkpoint(topic_info, std::chrono::steady_clock::now());
+  }
+  commit_transaction();
 }
 
 void BbrStorage::prepare_for_writing()
 {
   write_statement_ = database_->prepare_statement(
     "INSERT INTO messages (timestamp, topic_id, data, bbr_digest) VALUES (?, ?, ?, ?);");
+
+  group_commit_messages_ = static_cast<size_t>(
+    node_->get_parameter("group_commit_messages").as_int());
+  group_commit_period_ = std::chrono::milliseconds(
+    node_->get_parameter("group_commit_period_ms").as_int());
+
+  checkpoint_period_ =
+    std::chrono::milliseconds(node_->get_parameter("checkpoint_period_ms").as_int());
+  checkpoint_policy_ = make_checkpoint_policy(
+    static_cast<size_t>(node_->get_parameter("checkpoint_every_n").as_int()),
+    checkpoint_period_,
+    static_cast<size_t>(node_->get_parameter("checkpoint_bytes").as_int()));
+  if (checkpoint_period_.count() > 0) {
+    checkpoint_thread_ = std::thread(&BbrStorage::run_checkpoint_timer, this);
+  }
+
+  async_write_ = node_->get_parameter("async_write").as_bool();
+  if (!async_write_) {
+    return;
+  }
+
+  auto policy = node_->get_parameter("async_overflow_policy").as_string();
+  if (policy == "block") {
+    overflow_policy_ = OverflowPolicy::BLOCK;
+  } else if (policy == "drop_oldest") {
+    overflow_policy_ = OverflowPolicy::DROP_OLDEST;
+  } else if (policy == "drop_newest") {
+    overflow_policy_ = OverflowPolicy::DROP_NEWEST;
+  } else {
+    throw std::runtime_error("Unknown async_overflow_policy '" + policy + "'.");
+  }
+
+  queue_ = std::make_unique<MessageQueue>(
+    static_cast<size_t>(node_->get_parameter("async_queue_size").as_int()));
+  writer_thread_ = std::thread(&BbrStorage::run_writer, this);
+}
+
+void BbrStorage::enqueue(std::shared_ptr<const rosbag2_storage::SerializedBagMessage> message)
+{
+  if (stop_writer_) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (writer_error_) {
+      std::rethrow_exception(writer_error_);
+    }
+    throw std::runtime_error("Writer thread has been stopped.");
+  }
+
+  if (!queue_->try_push(std::move(message))) {
+    switch (overflow_policy_) {
+      case OverflowPolicy::DROP_NEWEST:
+        ++dropped_messages_;
+        return;
+      case OverflowPolicy::DROP_OLDEST:
+        {
+          std::shared_ptr<const rosbag2_storage::SerializedBagMessage> oldest;
+          while (!queue_->try_push(std::move(message))) {
+            if (queue_->try_pop(oldest)) {
+              ++dropped_messages_;
+            }
+          }
+        }
+        break;
+      case OverflowPolicy::BLOCK:
+        {
+          std::unique_lock<std::mutex> lock(write_mutex_);
+          while (!queue_->try_push(std::move(message))) {
+            if (stop_writer_) {
+              throw std::runtime_error("Writer thread stopped while waiting for queue space.");
+            }
+            space_available_.wait_for(lock, std::chrono::milliseconds(1));
+          }
+        }
+        break;
+    }
+  }
+
+  size_t depth = queue_->size();
+  size_t max_depth = max_queue_depth_.load(std::memory_order_relaxed);
+  while (depth > max_depth &&
+    !max_queue_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed))
+  {
+  }
+
+  // Pairs with the fence in run_writer so that either the writer sees the
+  // new message before sleeping or we see it sleeping and wake it up.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (writer_sleeping_) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    data_available_.notify_one();
+  }
+}
+
+void BbrStorage::run_writer()
+{
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  std::shared_ptr<const rosbag2_storage::SerializedBagMessage> message;
+  std::vector<std::shared_ptr<const rosbag2_storage::SerializedBagMessage>> batch;
+  while (true) {
+    writer_sleeping_ = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (queue_->empty() && !stop_writer_) {
+      if (in_transaction_) {
+        data_available_.wait_until(lock, transaction_start_ + group_commit_period_);
+      } else {
+        data_available_.wait(lock);
+      }
+    }
+    writer_sleeping_ = false;
+
+    try {
+      // Bound the batch so create_topic and flush get a chance at the lock.
+      batch.clear();
+      while (batch.size() < queue_->capacity() && queue_->try_pop(message)) {
+        batch.push_back(std::move(message));
+      }
+      write_messages(batch);
+      if (in_transaction_ &&
+        std::chrono::steady_clock::now() - transaction_start_ >= group_commit_period_)
+      {
+        commit_transaction();
+      }
+    } catch (const std::exception & e) {
+      ROSBAG2_STORAGE_DEFAULT_PLUGINS_LOG_ERROR("Writer thread failed: %s", e.what());
+      writer_error_ = std::current_exception();
+      stop_writer_ = true;
+    }
+
+    space_available_.notify_all();
+    queue_drained_.notify_all();
+    if (stop_writer_ && (writer_error_ || queue_->empty())) {
+      break;
+    }
+    lock.unlock();
+    lock.lock();
+  }
+}
+
+void BbrStorage::stop_writer()
+{
+  if (!writer_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    stop_writer_ = true;
+    data_available_.notify_one();
+  }
+  writer_thread_.join();
+
+  auto statistics = get_writer_statistics();
+  ROSBAG2_STORAGE_DEFAULT_PLUGINS_LOG_INFO(
+    "Writer queue: max depth %zu, dropped %" PRIu64 " messages.",
+    statistics.max_queue_depth, statistics.dropped_messages);
+}
+
+void BbrStorage::run_checkpoint_timer()
+{
+  // Writes only evaluate the policy for their own topic, so topics that go
+  // idle are anchored here once their period has elapsed.
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  while (!stop_checkpoint_timer_) {
+    auto now = std::chrono::steady_clock::now();
+    auto next_check = now + checkpoint_period_;
+    try {
+      bool anchored = false;
+      for (auto & topic_entry : topics_) {
+        auto & topic_info = topic_entry.second;
+        if (topic_info.checkpoint.messages == 0) {
+          continue;
+        }
+        if (checkpoint_policy_->should_checkpoint(topic_info.checkpoint, now)) {
+          anchor_checkpoint(topic_info, now);
+          anchored = true;
+        } else {
+          next_check =
+            std::min(next_check, topic_info.checkpoint.last_checkpoint + checkpoint_period_);
+        }
+      }
+      // No later write may come to commit the rows these checkpoints cover.
+      if (anchored) {
+        commit_transaction();
+      }
+    } catch (const std::exception & e) {
+      ROSBAG2_STORAGE_DEFAULT_PLUGINS_LOG_ERROR("Periodic checkpoint failed: %s", e.what());
+    }
+    checkpoint_timer_.wait_until(lock, next_check);
+  }
+}
+
+void BbrStorage::stop_checkpoint_timer()
+{
+  if (!checkpoint_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    stop_checkpoint_timer_ = true;
+    checkpoint_timer_.notify_one();
+  }
+  checkpoint_thread_.join();
+}
+
+BbrNode::RecordStatus BbrStorage::get_record_status(const std::string & topic_name) const
+{
+  if (!node_) {
+    return BbrNode::RecordStatus::UNKNOWN;
+  }
+  return node_->get_record_status(topic_name);
+}
+
+void BbrStorage::flush()
+{
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  if (writer_thread_.joinable()) {
+    queue_drained_.wait(lock, [this]() {return queue_->empty() || stop_writer_;});
+  }
+  commit_transaction();
+  sample_database_size();
+}
+
+BbrStorage::WriterStatistics BbrStorage::get_writer_statistics() const
+{
+  WriterStatistics statistics;
+  statistics.queue_depth = queue_ ? queue_->size() : 0;
+  statistics.max_queue_depth = max_queue_depth_;
+  statistics.dropped_messages = dropped_messages_;
+  return statistics;
+}
+
+void BbrStorage::begin_transaction()
+{
+  database_->prepare_statement("BEGIN TRANSACTION;")->execute_and_reset();
+  in_transaction_ = true;
+  transaction_messages_ = 0;
+  transaction_start_ = std::chrono::steady_clock::now();
+}
+
+void BbrStorage::commit_transaction()
+{
+  if (!in_transaction_) {
+    return;
+  }
+
+  // Digests are chained per topic and inserted in order on a single
+  // connection, so a crash before COMMIT drops only a suffix of each chain:
+  // the committed rows still verify, and at most group_commit_messages_ or
+  // group_commit_period_ worth of messages is lost. Checkpoints for the tail
+  // are published only after COMMIT so the ledger never anchors a digest
+  // that is not on disk.
+  database_->prepare_statement("COMMIT;")->execute_and_reset();
+  in_transaction_ = false;
+  sample_database_size();
+
+  for (const auto & pending : pending_checkpoints_) {
+    node_->publish_checkpoint(pending.nonce, pending.digest, pending.stamp);
+  }
+  pending_checkpoints_.clear();
 }
 
 void BbrStorage::prepare_for_reading()
 {
-  read_statement_ = database_->prepare_statement(
-    "SELECT data, timestamp, topics.name "
-    "FROM messages JOIN topics ON messages.topic_id = topics.id "
-    "ORDER BY messages.timestamp;");
-  message_result_ = read_statement_->execute_query<
-    std::shared_ptr<rcutils_uint8_array_t>, rcutils_time_point_value_t, std::string>();
-  current_message_row_ = message_result_.begin();
+  // The cursor only sees committed rows.
+  flush();
+
+  topic_names_.clear();
+  auto statement = database_->prepare_statement("SELECT id, name FROM topics;");
+  auto query_results = statement->execute_query<int, std::string>();
+  for (auto result : query_results) {
+    topic_names_.emplace(std::get<0>(result), std::get<1>(result));
+  }
+
+  // The cursor steps its own connection on a background thread, so the
+  // main connection stays free for metadata queries during playback.
+  read_cursor_ = std::make_unique<BbrReadCursor>(database_path_, make_read_query());
+}
+
+std::string BbrStorage::make_read_query() const
+{
+  std::vector<std::string> conditions;
+
+  if (!read_filter_.topics.empty()) {
+    std::string topic_ids;
+    for (const auto & topic_name : read_filter_.topics) {
+      for (const auto & entry : topic_names_) {
+        if (entry.second == topic_name) {
+          topic_ids += (topic_ids.empty() ? "" : ", ") + std::to_string(entry.first);
+        }
+      }
+    }
+    conditions.push_back(topic_ids.empty() ? "0" : "topic_id IN (" + topic_ids + ")");
+  }
+  if (read_filter_.start_time > 0) {
+    conditions.push_back("timestamp >= " + std::to_string(read_filter_.start_time));
+  }
+  if (read_filter_.end_time < INT64_MAX) {
+    conditions.push_back("timestamp <= " + std::to_string(read_filter_.end_time));
+  }
+
+  std::string query = "SELECT data, timestamp, topic_id FROM messages";
+  for (size_t i = 0; i < conditions.size(); ++i) {
+    query += (i == 0 ? " WHERE " : " AND ") + conditions[i];
+  }
+  return query + " ORDER BY timestamp;";
+}
+
+void BbrStorage::set_read_filter(const ReadFilter & filter)
+{
+  read_filter_ = filter;
+  read_cursor_.reset();
+}
+
+void BbrStorage::seek(rcutils_time_point_value_t timestamp)
+{
+  read_filter_.start_time = timestamp;
+  read_cursor_.reset();
+}
+
+void BbrStorage::create_indexes()
+{
+  auto start = std::chrono::steady_clock::now();
+
+  // SQLite builds each index with a single sort over the finished table,
+  // which is cheaper than keeping it up to date on every insert. The
+  // timestamp index already exists unless the bag was bulk loaded.
+  database_->prepare_statement(
+    "CREATE INDEX IF NOT EXISTS timestamp_idx ON messages (timestamp ASC);")
+  ->execute_and_reset();
+  // Topic and time filtered reads seek on this index instead of scanning.
+  database_->prepare_statement(
+    "CREATE INDEX IF NOT EXISTS topic_timestamp_idx ON messages (topic_id, timestamp ASC);")
+  ->execute_and_reset();
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  ROSBAG2_STORAGE_DEFAULT_PLUGINS_LOG_INFO("Built indexes in %.1f ms.", elapsed.count());
 }
 
 void BbrStorage::fill_topics_and_types()
@@ -251,6 +969,8 @@ bool BbrStorage::is_read_only(const rosbag2_storage::storage_interfaces::IOFlag
 
 rosbag2_storage::BagMetadata BbrStorage::get_metadata()
 {
+  flush();
+
   rosbag2_storage::BagMetadata metadata;
   metadata.storage_identifier = "bbr";
   metadata.relative_file_paths = {database_name_};
@@ -258,27 +978,16 @@ rosbag2_storage::BagMetadata BbrStorage::get_metadata()
   metadata.message_count = 0;
   metadata.topics_with_message_count = {};
 
-  auto statement = database_->prepare_statement(
-    "SELECT name, type, serialization_format, COUNT(messages.id), MIN(messages.timestamp), "
-    "MAX(messages.timestamp) "
-    "FROM messages JOIN topics on topics.id = messages.topic_id "
-    "GROUP BY topics.name;");
-  auto query_results = statement->execute_query<
-    std::string, std::string, std::string, int, rcutils_time_point_value_t,
-    rcutils_time_point_value_t>();
-
   rcutils_time_point_value_t min_time = INT64_MAX;
   rcutils_time_point_value_t max_time = 0;
-  for (auto result : query_results) {
-    metadata.topics_with_message_count.push_back(
-      {
-        {std::get<0>(result), std::get<1>(result), std::get<2>(result)},
-        static_cast<size_t>(std::get<3>(result))
-      });
-
-    metadata.message_count += std::get<3>(result);
-    min_time = std::get<4>(result) < min_time ? std::get<4>(result) : min_time;
-    max_time = std::get<5>(result) > max_time ? std::get<5>(result) : max_time;
+  for (const auto & summary : load_topic_summaries()) {
+    if (summary.message_count == 0) {
+      continue;
+    }
+    metadata.topics_with_message_count.push_back({summary.topic, summary.message_count});
+    metadata.message_count += summary.message_count;
+    min_time = summary.min_stamp < min_time ? summary.min_stamp : min_time;
+    max_time = summary.max_stamp > max_time ? summary.max_stamp : max_time;
   }
 
   if (metadata.message_count == 0) {
@@ -289,11 +998,175 @@ rosbag2_storage::BagMetadata BbrStorage::get_metadata()
   metadata.starting_time =
     std::chrono::time_point<std::chrono::high_resolution_clock>(std::chrono::nanoseconds(min_time));
   metadata.duration = std::chrono::nanoseconds(max_time) - std::chrono::nanoseconds(min_time);
-  metadata.bag_size = rosbag2_storage::FilesystemHelper::calculate_directory_size(database_name_);
+  metadata.bag_size = get_bag_size();
 
   return metadata;
 }
 
+BbrStorage::InclusionProof BbrStorage::get_inclusion_proof(
+  const std::string & topic_name, rcutils_time_point_value_t time_stamp)
+{
+  flush();
+
+  auto message_statement = database_->prepare_statement(
+    "SELECT messages.id, topics.id FROM messages JOIN topics ON topics.id = messages.topic_id "
+    "WHERE topics.name = ? AND messages.timestamp = ? ORDER BY messages.id LIMIT 1;");
+  message_statement->bind(topic_name, time_stamp);
+  rcutils_time_point_value_t message_id = -1;
+  int topic_id = 0;
+  for (auto result : message_statement->execute_query<rcutils_time_point_value_t, int>()) {
+    message_id = std::get<0>(result);
+    topic_id = std::get<1>(result);
+  }
+  if (message_id < 0) {
+    throw std::runtime_error("No message on topic '" + topic_name + "' at that time stamp.");
+  }
+
+  auto window_statement = database_->prepare_statement(
+    "SELECT first_id, last_id, root FROM merkle_roots "
+    "WHERE topic_id = ? AND first_id <= ? AND last_id >= ?;");
+  window_statement->bind(topic_id, message_id, message_id);
+  auto window_results = window_statement->execute_query<
+    rcutils_time_point_value_t, rcutils_time_point_value_t,
+    std::shared_ptr<rcutils_uint8_array_t>>();
+  auto window_row = window_results.begin();
+  if (window_row == window_results.end()) {
+    throw std::runtime_error(
+            "Message on topic '" + topic_name + "' is not in an anchored Merkle window.");
+  }
+  auto window = *window_row;
+  auto root = std::get<2>(window);
+
+  auto leaf_statement = database_->prepare_statement(
+    "SELECT id, bbr_digest FROM messages "
+    "WHERE topic_id = ? AND id >= ? AND id <= ? ORDER BY id;");
+  leaf_statement->bind(topic_id, std::get<0>(window), std::get<1>(window));
+  std::vector<BbrMerkleAccumulator::Digest> leaves;
+  InclusionProof proof = {};
+  for (auto result : leaf_statement->execute_query<
+      rcutils_time_point_value_t, std::shared_ptr<rcutils_uint8_array_t>>())
+  {
+    const auto & digest = std::get<1>(result);
+    if (std::get<0>(result) == message_id) {
+      proof.leaf_index = leaves.size();
+    }
+    leaves.emplace_back(digest->buffer, digest->buffer + digest->buffer_length);
+  }
+
+  BbrMerkleAccumulator accumulator;
+  proof.leaf_count = leaves.size();
+  proof.leaf = leaves[proof.leaf_index];
+  proof.root.assign(root->buffer, root->buffer + root->buffer_length);
+  proof.path = accumulator.prove(leaves, proof.leaf_index);
+  return proof;
+}
+
+uint64_t BbrStorage::get_bag_size() const
+{
+  return database_size_ + unsampled_bytes_;
+}
+
+void BbrStorage::sample_database_size()
+{
+  // Both pragmas are O(1); neither walks the database.
+  rcutils_time_point_value_t page_count = 0;
+  rcutils_time_point_value_t page_size = 0;
+  auto page_count_statement = database_->prepare_statement("PRAGMA page_count;");
+  for (auto result : page_count_statement->execute_query<rcutils_time_point_value_t>()) {
+    page_count = std::get<0>(result);
+  }
+  auto page_size_statement = database_->prepare_statement("PRAGMA page_size;");
+  for (auto result : page_size_statement->execute_query<rcutils_time_point_value_t>()) {
+    page_size = std::get<0>(result);
+  }
+
+  database_size_ = static_cast<uint64_t>(page_count * page_size);
+  unsampled_bytes_ = 0;
+  size_sampled_ = std::chrono::steady_clock::now();
+}
+
+std::vector<BbrStorage::TopicSummary> BbrStorage::load_topic_summaries()
+{
+  std::vector<TopicSummary> summaries;
+
+  // While recording the in-memory totals are authoritative.
+  if (node_) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    for (const auto & topic_entry : topics_) {
+      summaries.push_back(topic_entry.second.summary);
+    }
+    return summaries;
+  }
+
+  // Bags closed cleanly carry a summary table; older or interrupted bags
+  // fall back to aggregating the messages table.
+  SqliteStatement statement;
+  if (table_exists("topic_summary")) {
+    statement = database_->prepare_statement(
+      "SELECT name, type, serialization_format, message_count, min_timestamp, max_timestamp, "
+      "bytes "
+      "FROM topic_summary JOIN topics ON topics.id = topic_summary.topic_id;");
+  } else {
+    statement = database_->prepare_statement(
+      "SELECT name, type, serialization_format, COUNT(messages.id), MIN(messages.timestamp), "
+      "MAX(messages.timestamp), SUM(LENGTH(messages.data) + LENGTH(messages.bbr_digest)) "
+      "FROM messages JOIN topics on topics.id = messages.topic_id "
+      "GROUP BY topics.name;");
+  }
+  auto query_results = statement->execute_query<
+    std::string, std::string, std::string, rcutils_time_point_value_t,
+    rcutils_time_point_value_t, rcutils_time_point_value_t, rcutils_time_point_value_t>();
+
+  for (auto result : query_results) {
+    summaries.push_back(
+      {
+        {std::get<0>(result), std::get<1>(result), std::get<2>(result)},
+        static_cast<size_t>(std::get<3>(result)),
+        std::get<4>(result),
+        std::get<5>(result),
+        static_cast<uint64_t>(std::get<6>(result))
+      });
+  }
+  return summaries;
+}
+
+void BbrStorage::write_topic_summaries()
+{
+  database_->prepare_statement(
+    "CREATE TABLE IF NOT EXISTS topic_summary("
+    "topic_id INTEGER PRIMARY KEY,"
+    "message_count INTEGER NOT NULL,"
+    "min_timestamp INTEGER NOT NULL,"
+    "max_timestamp INTEGER NOT NULL,"
+    "bytes INTEGER NOT NULL);")->execute_and_reset();
+
+  database_->prepare_statement("BEGIN TRANSACTION;")->execute_and_reset();
+  auto insert_summary = database_->prepare_statement(
+    "INSERT OR REPLACE INTO topic_summary "
+    "(topic_id, message_count, min_timestamp, max_timestamp, bytes) VALUES (?, ?, ?, ?, ?);");
+  for (const auto & topic_entry : topics_) {
+    const auto & summary = topic_entry.second.summary;
+    insert_summary->bind(topic_entry.second.id,
+      static_cast<rcutils_time_point_value_t>(summary.message_count),
+      summary.min_stamp, summary.max_stamp,
+      static_cast<rcutils_time_point_value_t>(summary.bytes));
+    insert_summary->execute_and_reset();
+  }
+  database_->prepare_statement("COMMIT;")->execute_and_reset();
+}
+
+bool BbrStorage::table_exists(const std::string & table_name)
+{
+  auto statement = database_->prepare_statement(
+    "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = ?;");
+  statement->bind(table_name);
+  auto query_results = statement->execute_query<int>();
+  for (auto result : query_results) {
+    return std::get<0>(result) > 0;
+  }
+  return false;
+}
+
 }  // namespace rosbag2_storage_plugins
 
 #include "pluginlib/class_list_macros.hpp"  // NOLINT
@@ -0,0 +1,297 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_helper.hpp"
+
+#include "rosbag2_storage/ros_helper.hpp"
+#include "rosbag2_storage/storage_interfaces/base_io_interface.hpp"
+#include "rosbag2_storage_default_plugins/sqlite/sqlite_wrapper.hpp"
+
+#include "Poco/HMACEngine.h"
+
+#include "bbr_protobuf/proto/bbr/hash.pb.h"
+
+namespace bbr = rosbag2_storage_plugins;
+using BbrHmacContext = bbr::BbrHmacContext;
+
+namespace
+{
+
+class SHA256Engine
+  : public Poco::Crypto::DigestEngine
+{
+public:
+  enum
+  {
+    BLOCK_SIZE = 64,
+    DIGEST_SIZE = 32
+  };
+
+  SHA256Engine()
+  : DigestEngine("SHA256")
+  {}
+};
+
+// Runs fn the given number of times and returns the rate in calls per second.
+double measure(size_t iterations, const std::function<void()> & fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    fn();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return iterations / elapsed.count();
+}
+
+void report(const char * name, size_t payload_size, double rate)
+{
+  std::printf("%-32s %8zu B %12.0f hashes/s %10.1f MB/s\n",
+    name, payload_size, rate, rate * payload_size / (1024.0 * 1024.0));
+}
+
+void report(const char * name, double rate)
+{
+  std::printf("%-32s %12.0f ops/s\n", name, rate);
+}
+
+// Chained HMAC-SHA256 as done on the write path: every digest keys the next.
+void benchmark_hmac(size_t payload_size, size_t iterations)
+{
+  std::vector<unsigned char> data(payload_size, 0xa5);
+  std::vector<unsigned char> key(SHA256Engine::DIGEST_SIZE, 0x0f);
+
+  double rate = measure(iterations, [&]() {
+        Poco::HMACEngine<SHA256Engine> hmac(
+          reinterpret_cast<const char *>(key.data()), key.size());
+        hmac.update(data.data(), data.size());
+        const auto & digest = hmac.digest();
+        std::copy(digest.begin(), digest.end(), key.begin());
+      });
+  report("Poco::HMACEngine per call", payload_size, rate);
+
+  BbrHmacContext context;
+  rate = measure(iterations, [&]() {
+        context.init(key.data(), key.size());
+        context.update(data.data(), data.size());
+        const auto & digest = context.digest();
+        std::copy(digest.begin(), digest.end(), key.begin());
+      });
+  report("BbrHmacContext reused", payload_size, rate);
+}
+
+// Message header encoding alone, then the full message digest in each format.
+void benchmark_message_header(size_t iterations)
+{
+  rcutils_time_point_value_t stamp = 1546300800000000000;
+  size_t sink = 0;
+
+  std::string message_info_str;
+  double rate = measure(iterations, [&]() {
+        auto message_info = MessageInfo();
+        message_info.set_stamp(stamp++);
+        message_info.SerializeToString(&message_info_str);
+        sink += message_info_str.size();
+      });
+  report("MessageInfo protobuf encode", rate);
+
+  rate = measure(iterations, [&]() {
+        auto header = bbr::encodeMessageHeader(stamp++);
+        sink += header.size;
+      });
+  report("Canonical header encode", rate);
+
+  std::vector<unsigned char> data(64, 0xa5);
+  auto payload = rosbag2_storage::make_serialized_message(data.data(), data.size());
+  auto nonce = rosbag2_storage::make_serialized_message(data.data(), bbr::NONCE_SIZE);
+
+  bbr::BbrHelper helper(bbr::MESSAGE_FORMAT_PROTOBUF);
+  rate = measure(iterations, [&]() {
+        nonce = helper.computeMessageDigest(*nonce, stamp++, *payload);
+      });
+  report("Message digest, protobuf header", data.size(), rate);
+
+  helper.setMessageFormat(bbr::MESSAGE_FORMAT_CANONICAL);
+  rate = measure(iterations, [&]() {
+        nonce = helper.computeMessageDigest(*nonce, stamp++, *payload);
+      });
+  report("Message digest, canonical header", data.size(), rate);
+
+  if (sink == 0) {
+    std::printf("\n");
+  }
+}
+
+// Small messages of independent topics, hashed one call at a time and then
+// as batches on every SHA-256 backend that passes its self-test.
+void benchmark_batch_digest(size_t payload_size, size_t topics, size_t iterations)
+{
+  std::vector<unsigned char> data(payload_size * topics, 0xa5);
+  std::vector<unsigned char> keys(bbr::SHA256_DIGEST_SIZE * topics, 0x0f);
+  std::vector<unsigned char> digests(bbr::SHA256_DIGEST_SIZE * topics);
+  std::vector<bbr::HmacSha256Job> jobs(topics);
+  for (size_t i = 0; i < topics; ++i) {
+    jobs[i] = {
+      keys.data() + i * bbr::SHA256_DIGEST_SIZE, bbr::SHA256_DIGEST_SIZE, nullptr, 0,
+      data.data() + i * payload_size, payload_size,
+      digests.data() + i * bbr::SHA256_DIGEST_SIZE
+    };
+  }
+
+  BbrHmacContext context;
+  double rate = measure(iterations, [&]() {
+        for (const auto & job : jobs) {
+          context.init(job.key, job.key_length);
+          context.update(job.data, job.data_length);
+          const auto & digest = context.digest();
+          std::copy(digest.begin(), digest.end(), job.digest);
+        }
+      }) * topics;
+  report("BbrHmacContext per message", payload_size, rate);
+
+  const bbr::Sha256Backend backends[] = {
+    bbr::Sha256Backend::SCALAR, bbr::Sha256Backend::SHA_NI, bbr::Sha256Backend::AVX2
+  };
+  for (auto backend : backends) {
+    std::string name = std::string("Batch, ") + bbr::getSha256BackendName(backend);
+    if (!bbr::selfTestSha256Backend(backend)) {
+      std::printf("%-32s unsupported or failed its self-test\n", name.c_str());
+      continue;
+    }
+    rate = measure(iterations, [&]() {
+          bbr::computeHmacSha256(jobs.data(), jobs.size(), backend);
+        }) * topics;
+    report(name.c_str(), payload_size, rate);
+  }
+}
+
+// Chained message digests through BbrHelper for each digest_algorithm, the
+// way BbrStorage digests a single topic.
+void benchmark_digest_algorithm(size_t payload_size, size_t iterations)
+{
+  std::vector<unsigned char> payload(payload_size, 0xa5);
+  auto data = rosbag2_storage::make_serialized_message(payload.data(), payload.size());
+
+  const uint8_t algorithms[] = {
+    bbr::DIGEST_ALGORITHM_HMAC_SHA256, bbr::DIGEST_ALGORITHM_BLAKE3_KEYED
+  };
+  for (auto algorithm : algorithms) {
+    bbr::BbrHelper helper(bbr::MESSAGE_FORMAT_CANONICAL, algorithm);
+    auto digest = helper.createNonce();
+    rcutils_time_point_value_t stamp = 0;
+    double rate = measure(iterations, [&]() {
+          digest = helper.computeMessageDigest(*digest, ++stamp, *data);
+        });
+    std::string name = std::string("Chain, ") + bbr::getDigestAlgorithmName(algorithm);
+    report(name.c_str(), payload_size, rate);
+  }
+}
+
+// Inserts messages the way BbrStorage records them, in group-committed
+// transactions, then builds the indexes a closed bag carries. The bulk
+// profile applies the recording_profile=bulk_load pragmas and defers the
+// timestamp index to close.
+void benchmark_insert(bool bulk_load, size_t messages, size_t payload_size)
+{
+  const char * database_path = "bbr_benchmark.db3";
+  std::remove(database_path);
+  std::remove("bbr_benchmark.db3-wal");
+  std::remove("bbr_benchmark.db3-shm");
+
+  {
+    bbr::SqliteWrapper database(
+      database_path, rosbag2_storage::storage_interfaces::IOFlag::READ_WRITE);
+    if (bulk_load) {
+      database.prepare_statement("PRAGMA page_size = 65536;")->execute_and_reset();
+      database.prepare_statement("PRAGMA cache_size = -262144;")->execute_and_reset();
+      auto journal_mode = database.prepare_statement("PRAGMA journal_mode = WAL;");
+      auto query_results = journal_mode->execute_query<std::string>();
+      for (auto result : query_results) {
+        (void)result;
+      }
+      database.prepare_statement("PRAGMA synchronous = NORMAL;")->execute_and_reset();
+    }
+    database.prepare_statement(
+      "CREATE TABLE messages(id INTEGER PRIMARY KEY, topic_id INTEGER NOT NULL, "
+      "timestamp INTEGER NOT NULL, data BLOB NOT NULL, bbr_digest BLOB NOT NULL);")
+    ->execute_and_reset();
+    if (!bulk_load) {
+      database.prepare_statement("CREATE INDEX timestamp_idx ON messages (timestamp ASC);")
+      ->execute_and_reset();
+    }
+
+    std::vector<unsigned char> data(payload_size, 0xa5);
+    auto payload = rosbag2_storage::make_serialized_message(data.data(), data.size());
+    auto digest = rosbag2_storage::make_serialized_message(data.data(), 32);
+    auto insert = database.prepare_statement(
+      "INSERT INTO messages (timestamp, topic_id, data, bbr_digest) VALUES (?, ?, ?, ?);");
+
+    // Stamps from several topics interleave slightly out of order.
+    rcutils_time_point_value_t stamp = 1546300800000000000;
+    size_t written = 0;
+    double rate = measure(messages / 1000, [&]() {
+          database.prepare_statement("BEGIN TRANSACTION;")->execute_and_reset();
+          for (size_t i = 0; i < 1000; ++i, ++written) {
+            int topic_id = static_cast<int>(written % 8);
+            rcutils_time_point_value_t jitter = topic_id * 1000;
+            insert->bind(stamp + jitter, topic_id, payload, digest);
+            insert->execute_and_reset();
+            stamp += 1000000;
+          }
+          database.prepare_statement("COMMIT;")->execute_and_reset();
+        }) * 1000;
+    report(bulk_load ? "Insert, bulk_load profile" : "Insert, default profile",
+      payload_size, rate);
+
+    rate = measure(1, [&]() {
+          database.prepare_statement(
+            "CREATE INDEX IF NOT EXISTS timestamp_idx ON messages (timestamp ASC);")
+          ->execute_and_reset();
+          database.prepare_statement(
+            "CREATE INDEX IF NOT EXISTS topic_timestamp_idx ON messages (topic_id, timestamp ASC);")
+          ->execute_and_reset();
+        });
+    std::printf("%-32s %8zu msgs %10.1f ms\n",
+      bulk_load ? "Close, bulk_load profile" : "Close, default profile",
+      written, 1000.0 / rate);
+  }
+
+  std::remove(database_path);
+  std::remove("bbr_benchmark.db3-wal");
+  std::remove("bbr_benchmark.db3-shm");
+}
+
+}  // namespace
+
+int main()
+{
+  benchmark_hmac(64, 200000);
+  benchmark_hmac(1024 * 1024, 500);
+  benchmark_message_header(1000000);
+  benchmark_batch_digest(64, 64, 20000);
+  benchmark_batch_digest(200, 64, 20000);
+  benchmark_digest_algorithm(256, 200000);
+  benchmark_digest_algorithm(4 * 1024 * 1024, 50);
+  benchmark_insert(false, 200000, 256);
+  benchmark_insert(true, 200000, 256);
+
+  return 0;
+}
@@ -0,0 +1,663 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Recomputes the digest chains of a recorded bag and the Merkle roots
+// anchored over its checkpoint windows. Unsegmented chains and Merkle
+// windows are checked in one ordered pass over messages, whose rows are
+// handed to verifier threads by topic, so a bag is read once whether or not
+// it has indexes. Segments of segmented topics are id ranges and are
+// verified in parallel, each worker on its own connection and BbrHelper.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_helper.hpp"
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_merkle.hpp"
+
+#include "rosbag2_storage/storage_interfaces/base_io_interface.hpp"
+#include "rosbag2_storage_default_plugins/sqlite/sqlite_exception.hpp"
+#include "rosbag2_storage_default_plugins/sqlite/sqlite_wrapper.hpp"
+
+namespace bbr = rosbag2_storage_plugins;
+
+namespace
+{
+
+struct TopicChain
+{
+  int id;
+  rosbag2_storage::TopicMetadata topic;
+  std::shared_ptr<rcutils_uint8_array_t> nonce;
+  std::shared_ptr<rcutils_uint8_array_t> digest;
+  uint8_t message_format;
+  size_t segment_size;
+  uint8_t digest_algorithm;
+};
+
+// A unit of parallel work: one segment of a segmented topic chain.
+struct ChainSegment
+{
+  size_t topic;
+  uint64_t index;
+  rcutils_time_point_value_t first_id;
+  rcutils_time_point_value_t last_id;
+  size_t message_count;
+  std::shared_ptr<rcutils_uint8_array_t> root;
+  std::shared_ptr<rcutils_uint8_array_t> link;
+};
+
+struct ChainResult
+{
+  bool verified;
+  size_t messages;
+  uint64_t bytes;
+  // First broken link, valid when verified is false.
+  size_t broken_index;
+  rcutils_time_point_value_t broken_id;
+  rcutils_time_point_value_t broken_stamp;
+  std::string error;
+};
+
+struct MerkleWindow
+{
+  uint64_t index;
+  rcutils_time_point_value_t first_id;
+  rcutils_time_point_value_t last_id;
+  size_t leaf_count;
+  std::shared_ptr<rcutils_uint8_array_t> root;
+};
+
+// State of one topic in the ordered pass: its chain, unless the topic is
+// segmented and verified per segment, and its anchored Merkle windows.
+struct TopicScan
+{
+  size_t topic;
+  bool chain;
+  std::unique_ptr<bbr::BbrHelper> helper;
+  std::shared_ptr<rcutils_uint8_array_t> key;
+  std::vector<MerkleWindow> windows;
+  size_t next_window;
+  bbr::BbrMerkleAccumulator merkle;
+  ChainResult result;
+};
+
+struct MessageRow
+{
+  rcutils_time_point_value_t id;
+  rcutils_time_point_value_t stamp;
+  std::shared_ptr<rcutils_uint8_array_t> data;
+  std::shared_ptr<rcutils_uint8_array_t> digest;
+  TopicScan * scan;
+};
+
+// Hands batches of rows from the reader to one verifier. Bounded so the
+// reader runs at most a few batches ahead of hashing.
+class RowQueue
+{
+public:
+  void push(std::vector<MessageRow> && batch)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_available_.wait(lock, [this]() {return batches_.size() < MAX_BATCHES;});
+    batches_.push_back(std::move(batch));
+    data_available_.notify_one();
+  }
+
+  // Returns false once the queue is closed and empty.
+  bool pop(std::vector<MessageRow> & batch)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    data_available_.wait(lock, [this]() {return !batches_.empty() || closed_;});
+    if (batches_.empty()) {
+      return false;
+    }
+    batch = std::move(batches_.front());
+    batches_.pop_front();
+    space_available_.notify_one();
+    return true;
+  }
+
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    data_available_.notify_one();
+  }
+
+private:
+  static const size_t MAX_BATCHES = 16;
+
+  std::mutex mutex_;
+  std::condition_variable data_available_;
+  std::condition_variable space_available_;
+  std::deque<std::vector<MessageRow>> batches_;
+  bool closed_ = false;
+};
+
+const size_t ROW_BATCH_SIZE = 256;
+
+bool equal(const rcutils_uint8_array_t & a, const rcutils_uint8_array_t & b)
+{
+  return a.buffer_length == b.buffer_length &&
+         std::memcmp(a.buffer, b.buffer, a.buffer_length) == 0;
+}
+
+std::unique_ptr<bbr::SqliteWrapper> open_database(const std::string & database_path)
+{
+  return std::make_unique<bbr::SqliteWrapper>(
+    database_path, rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+}
+
+bool has_column(
+  bbr::SqliteWrapper & database, const std::string & table, const std::string & column)
+{
+  try {
+    database.prepare_statement("SELECT " + column + " FROM " + table + " LIMIT 1;");
+  } catch (const bbr::SqliteException &) {
+    return false;
+  }
+  return true;
+}
+
+std::vector<TopicChain> load_topics(bbr::SqliteWrapper & database)
+{
+  // Bags recorded before bbr_format existed all use the protobuf header,
+  // bags without bbr_segment_size have a single chain per topic, and bags
+  // without bbr_digest_algorithm chain with HMAC-SHA256.
+  std::string format_column = has_column(database, "topics", "bbr_format") ?
+    "bbr_format" : std::to_string(bbr::MESSAGE_FORMAT_PROTOBUF);
+  std::string segment_column = has_column(database, "topics", "bbr_segment_size") ?
+    "bbr_segment_size" : "0";
+  std::string algorithm_column = has_column(database, "topics", "bbr_digest_algorithm") ?
+    "bbr_digest_algorithm" : std::to_string(bbr::DIGEST_ALGORITHM_HMAC_SHA256);
+
+  auto statement = database.prepare_statement(
+    "SELECT id, name, type, serialization_format, bbr_nonce, bbr_digest, " +
+    format_column + ", " + segment_column + ", " + algorithm_column +
+    " FROM topics ORDER BY id;");
+  auto query_results = statement->execute_query<
+    int, std::string, std::string, std::string,
+    std::shared_ptr<rcutils_uint8_array_t>, std::shared_ptr<rcutils_uint8_array_t>,
+    int, int, int>();
+
+  std::vector<TopicChain> topics;
+  for (auto result : query_results) {
+    topics.push_back(
+      {
+        std::get<0>(result),
+        {std::get<1>(result), std::get<2>(result), std::get<3>(result)},
+        std::get<4>(result),
+        std::get<5>(result),
+        static_cast<uint8_t>(std::get<6>(result)),
+        static_cast<size_t>(std::get<7>(result)),
+        static_cast<uint8_t>(std::get<8>(result))
+      });
+  }
+  return topics;
+}
+
+std::vector<ChainSegment> load_segments(
+  bbr::SqliteWrapper & database, const std::vector<TopicChain> & topics)
+{
+  std::vector<ChainSegment> segments;
+  for (size_t i = 0; i < topics.size(); ++i) {
+    if (topics[i].segment_size == 0) {
+      continue;
+    }
+    auto statement = database.prepare_statement(
+      "SELECT segment_index, first_id, last_id, message_count, root, link "
+      "FROM segments WHERE topic_id = ? ORDER BY segment_index;");
+    statement->bind(topics[i].id);
+    auto query_results = statement->execute_query<
+      rcutils_time_point_value_t, rcutils_time_point_value_t, rcutils_time_point_value_t, int,
+      std::shared_ptr<rcutils_uint8_array_t>, std::shared_ptr<rcutils_uint8_array_t>>();
+    for (auto result : query_results) {
+      segments.push_back(
+        {
+          i,
+          static_cast<uint64_t>(std::get<0>(result)),
+          std::get<1>(result),
+          std::get<2>(result),
+          static_cast<size_t>(std::get<3>(result)),
+          std::get<4>(result),
+          std::get<5>(result)
+        });
+    }
+  }
+  return segments;
+}
+
+std::vector<MerkleWindow> load_merkle_windows(bbr::SqliteWrapper & database, int topic_id)
+{
+  std::vector<MerkleWindow> windows;
+  if (!has_column(database, "merkle_roots", "root")) {
+    return windows;
+  }
+  auto statement = database.prepare_statement(
+    "SELECT window_index, first_id, last_id, leaf_count, root "
+    "FROM merkle_roots WHERE topic_id = ? ORDER BY window_index;");
+  statement->bind(topic_id);
+  auto query_results = statement->execute_query<
+    rcutils_time_point_value_t, rcutils_time_point_value_t, rcutils_time_point_value_t, int,
+    std::shared_ptr<rcutils_uint8_array_t>>();
+  for (auto result : query_results) {
+    windows.push_back(
+      {
+        static_cast<uint64_t>(std::get<0>(result)),
+        std::get<1>(result),
+        std::get<2>(result),
+        static_cast<size_t>(std::get<3>(result)),
+        std::get<4>(result)
+      });
+  }
+  return windows;
+}
+
+// Counted in one pass rather than per topic, which would scan messages once
+// per topic in bags without a topic index.
+std::unordered_map<int, size_t> count_messages(bbr::SqliteWrapper & database)
+{
+  auto statement = database.prepare_statement(
+    "SELECT topic_id, COUNT(*) FROM messages GROUP BY topic_id;");
+  std::unordered_map<int, size_t> counts;
+  for (auto result : statement->execute_query<int, rcutils_time_point_value_t>()) {
+    counts[std::get<0>(result)] = static_cast<size_t>(std::get<1>(result));
+  }
+  return counts;
+}
+
+// Segment links chain the segment roots of a topic, starting at its digest.
+// Together with a count check this ties every message to exactly one
+// segment in the right order.
+bool verify_segment_links(
+  bbr::SqliteWrapper & database,
+  const std::vector<TopicChain> & topics,
+  const std::vector<ChainSegment> & segments)
+{
+  bbr::BbrHelper helper;
+  bool verified = true;
+  std::vector<std::shared_ptr<rcutils_uint8_array_t>> links(topics.size());
+  std::vector<uint64_t> next_index(topics.size(), 0);
+  std::vector<size_t> messages(topics.size(), 0);
+  std::vector<bool> broken(topics.size(), false);
+  for (size_t i = 0; i < topics.size(); ++i) {
+    links[i] = topics[i].digest;
+  }
+
+  for (const auto & segment : segments) {
+    size_t t = segment.topic;
+    if (broken[t]) {
+      continue;
+    }
+    auto link = helper.computeSegmentLink(*links[t], segment.index, *segment.root);
+    if (segment.index != next_index[t] || !equal(*link, *segment.link)) {
+      std::printf("Topic '%s': segment %" PRIu64 " is not linked to its predecessor.\n",
+        topics[t].topic.name.c_str(), segment.index);
+      broken[t] = true;
+      verified = false;
+      continue;
+    }
+    links[t] = segment.link;
+    next_index[t] += 1;
+    messages[t] += segment.message_count;
+  }
+
+  if (std::none_of(topics.begin(), topics.end(),
+    [](const TopicChain & chain) {return chain.segment_size > 0;}))
+  {
+    return verified;
+  }
+  auto counts = count_messages(database);
+  for (size_t t = 0; t < topics.size(); ++t) {
+    if (topics[t].segment_size > 0 && !broken[t] && counts[topics[t].id] != messages[t]) {
+      std::printf("Topic '%s': messages are not covered by its segments.\n",
+        topics[t].topic.name.c_str());
+      verified = false;
+    }
+  }
+  return verified;
+}
+
+// Each topic digest is keyed by its nonce, and each nonce after the first
+// is derived from the previous topic, linking the topics into one chain.
+bool verify_topics(const std::vector<TopicChain> & topics)
+{
+  bbr::BbrHelper helper;
+  bool verified = true;
+  for (size_t i = 0; i < topics.size(); ++i) {
+    const auto & chain = topics[i];
+    if (!equal(*helper.computeTopicDigest(chain.nonce, chain.topic), *chain.digest)) {
+      std::printf("Topic '%s': topic digest does not match its nonce.\n",
+        chain.topic.name.c_str());
+      verified = false;
+    }
+    if (i > 0) {
+      const auto & previous = topics[i - 1];
+      if (!equal(*helper.computeTopicNonce(previous.digest, previous.topic), *chain.nonce)) {
+        std::printf("Topic '%s': nonce is not linked to topic '%s'.\n",
+          chain.topic.name.c_str(), previous.topic.name.c_str());
+        verified = false;
+      }
+    }
+  }
+  return verified;
+}
+
+ChainResult verify_segment(
+  bbr::SqliteWrapper & database, bbr::BbrHelper & helper,
+  const TopicChain & chain, const ChainSegment & segment)
+{
+  ChainResult result = {true, 0, 0, 0, 0, 0, ""};
+  helper.setMessageFormat(chain.message_format);
+  helper.setDigestAlgorithm(chain.digest_algorithm);
+
+  // The id range is a rowid range, so this reads only the segment's span.
+  auto statement = database.prepare_statement(
+    "SELECT id, timestamp, data, bbr_digest FROM messages "
+    "WHERE topic_id = ? AND id >= ? AND id <= ? ORDER BY id;");
+  statement->bind(chain.id, segment.first_id, segment.last_id);
+  auto key = helper.computeSegmentKey(*chain.digest, segment.index);
+  auto query_results = statement->execute_query<
+    rcutils_time_point_value_t, rcutils_time_point_value_t,
+    std::shared_ptr<rcutils_uint8_array_t>, std::shared_ptr<rcutils_uint8_array_t>>();
+
+  for (auto row : query_results) {
+    const auto & data = std::get<2>(row);
+    const auto & digest = std::get<3>(row);
+    if (!helper.verifyMessageDigest(*key, std::get<1>(row), *data, *digest)) {
+      result.verified = false;
+      result.broken_index = result.messages;
+      result.broken_id = std::get<0>(row);
+      result.broken_stamp = std::get<1>(row);
+      return result;
+    }
+    key = digest;
+    result.messages += 1;
+    result.bytes += data->buffer_length + digest->buffer_length;
+  }
+
+  if (result.messages != segment.message_count || !equal(*key, *segment.root)) {
+    result.verified = false;
+    result.error = "segment " + std::to_string(segment.index) + " does not end at its root";
+  }
+  return result;
+}
+
+void scan_row(const MessageRow & row)
+{
+  auto & scan = *row.scan;
+  auto & result = scan.result;
+  if (!result.verified) {
+    return;
+  }
+
+  if (scan.chain) {
+    if (!scan.helper->verifyMessageDigest(*scan.key, row.stamp, *row.data, *row.digest)) {
+      result.verified = false;
+      result.broken_index = result.messages;
+      result.broken_id = row.id;
+      result.broken_stamp = row.stamp;
+      return;
+    }
+    scan.key = row.digest;
+    result.messages += 1;
+    result.bytes += row.data->buffer_length + row.digest->buffer_length;
+  }
+
+  // Windows cover consecutive messages of the topic; rows before the next
+  // window and after the last one are simply not anchored by a root.
+  if (scan.next_window == scan.windows.size() ||
+    row.id < scan.windows[scan.next_window].first_id)
+  {
+    return;
+  }
+  const auto & window = scan.windows[scan.next_window];
+  scan.merkle.append(row.digest->buffer, row.digest->buffer_length);
+  if (row.id < window.last_id) {
+    return;
+  }
+  auto root = scan.merkle.root();
+  if (row.id != window.last_id || scan.merkle.size() != window.leaf_count ||
+    root.size() != window.root->buffer_length ||
+    std::memcmp(root.data(), window.root->buffer, root.size()) != 0)
+  {
+    result.verified = false;
+    result.error = "Merkle window " + std::to_string(window.index) + " does not match its root";
+    return;
+  }
+  scan.merkle.reset();
+  scan.next_window += 1;
+}
+
+// Streams messages once in id order, which needs no index, and dispatches
+// every row to the verifier that owns its topic. Chains are independent,
+// so topics hash in parallel while each chain still advances in order.
+void scan_messages(
+  bbr::SqliteWrapper & database, std::vector<TopicChain> & topics,
+  std::vector<std::unique_ptr<TopicScan>> & scans, size_t threads)
+{
+  std::unordered_map<int, TopicScan *> scans_by_id;
+  std::string topic_ids;
+  for (auto & scan : scans) {
+    const auto & chain = topics[scan->topic];
+    scans_by_id[chain.id] = scan.get();
+    topic_ids += (topic_ids.empty() ? "" : ", ") + std::to_string(chain.id);
+  }
+
+  size_t verifier_count = std::max<size_t>(1, std::min(threads, scans.size()));
+  std::vector<RowQueue> queues(verifier_count);
+  std::vector<std::thread> verifiers;
+  for (size_t v = 0; v < verifier_count; ++v) {
+    verifiers.emplace_back([&queues, v]() {
+        std::vector<MessageRow> batch;
+        while (queues[v].pop(batch)) {
+          for (const auto & row : batch) {
+            try {
+              scan_row(row);
+            } catch (const std::exception & e) {
+              row.scan->result.verified = false;
+              row.scan->result.error = e.what();
+            }
+          }
+        }
+      });
+  }
+  std::unordered_map<TopicScan *, size_t> owners;
+  for (size_t i = 0; i < scans.size(); ++i) {
+    owners[scans[i].get()] = i % verifier_count;
+  }
+
+  std::vector<std::vector<MessageRow>> batches(verifier_count);
+  std::string error;
+  try {
+    auto statement = database.prepare_statement(
+      "SELECT id, topic_id, timestamp, data, bbr_digest FROM messages "
+      "WHERE topic_id IN (" + topic_ids + ") ORDER BY id;");
+    auto query_results = statement->execute_query<
+      rcutils_time_point_value_t, int, rcutils_time_point_value_t,
+      std::shared_ptr<rcutils_uint8_array_t>, std::shared_ptr<rcutils_uint8_array_t>>();
+    for (auto row : query_results) {
+      auto scan = scans_by_id.at(std::get<1>(row));
+      auto owner = owners[scan];
+      batches[owner].push_back(
+        {std::get<0>(row), std::get<2>(row), std::get<3>(row), std::get<4>(row), scan});
+      if (batches[owner].size() == ROW_BATCH_SIZE) {
+        queues[owner].push(std::move(batches[owner]));
+        batches[owner].clear();
+      }
+    }
+  } catch (const std::exception & e) {
+    error = e.what();
+  }
+  for (size_t v = 0; v < verifier_count; ++v) {
+    if (!batches[v].empty()) {
+      queues[v].push(std::move(batches[v]));
+    }
+    queues[v].close();
+  }
+  for (auto & verifier : verifiers) {
+    verifier.join();
+  }
+
+  for (auto & scan : scans) {
+    auto & result = scan->result;
+    if (!error.empty() && result.verified) {
+      result.verified = false;
+      result.error = error;
+    } else if (result.verified && scan->next_window < scan->windows.size()) {
+      result.verified = false;
+      result.error = "Merkle window " +
+        std::to_string(scan->windows[scan->next_window].index) + " is missing messages";
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  if (argc < 2) {
+    std::fprintf(stderr,
+      "Usage: %s <database.db3> [threads]\n"
+      "Checks topic digests, message digest chains, segment links and the\n"
+      "Merkle roots of checkpoint windows.\n", argv[0]);
+    return 2;
+  }
+  std::string database_path = argv[1];
+  size_t threads = argc > 2 ?
+    std::max<size_t>(1, std::strtoul(argv[2], nullptr, 10)) :
+    std::max(1u, std::thread::hardware_concurrency());
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<TopicChain> topics;
+  std::vector<ChainSegment> segments;
+  std::vector<std::unique_ptr<TopicScan>> scans;
+  bool verified = true;
+  try {
+    auto database = open_database(database_path);
+    topics = load_topics(*database);
+    segments = load_segments(*database, topics);
+    verified = verify_topics(topics) && verified;
+    verified = verify_segment_links(*database, topics, segments) && verified;
+
+    // Segmented topics only join the ordered pass for their Merkle windows.
+    for (size_t i = 0; i < topics.size(); ++i) {
+      auto scan = std::make_unique<TopicScan>();
+      scan->topic = i;
+      scan->chain = topics[i].segment_size == 0;
+      scan->windows = load_merkle_windows(*database, topics[i].id);
+      scan->next_window = 0;
+      scan->result = {true, 0, 0, 0, 0, 0, ""};
+      if (!scan->chain && scan->windows.empty()) {
+        continue;
+      }
+      scan->helper = std::make_unique<bbr::BbrHelper>();
+      scan->helper->setMessageFormat(topics[i].message_format);
+      scan->helper->setDigestAlgorithm(topics[i].digest_algorithm);
+      scan->key = topics[i].digest;
+      scans.push_back(std::move(scan));
+    }
+    if (!scans.empty()) {
+      scan_messages(*database, topics, scans, threads);
+    }
+  } catch (const std::exception & e) {
+    std::fprintf(stderr, "Failed to open '%s': %s\n", database_path.c_str(), e.what());
+    return 2;
+  }
+
+  // Workers claim the next unverified segment until none are left.
+  std::vector<ChainResult> segment_results(segments.size());
+  std::atomic<size_t> next_segment(0);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < std::max<size_t>(1, std::min(threads, segments.size())); ++t) {
+    workers.emplace_back([&]() {
+        bbr::BbrHelper helper;
+        std::unique_ptr<bbr::SqliteWrapper> database;
+        for (size_t i = next_segment++; i < segments.size(); i = next_segment++) {
+          try {
+            if (!database) {
+              database = open_database(database_path);
+            }
+            segment_results[i] =
+              verify_segment(*database, helper, topics[segments[i].topic], segments[i]);
+          } catch (const std::exception & e) {
+            segment_results[i] = {false, 0, 0, 0, 0, 0, e.what()};
+          }
+        }
+      });
+  }
+  for (auto & worker : workers) {
+    worker.join();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  // Segments are ordered by topic and index, so the first failure met per
+  // topic is its first broken link; message positions count from the start
+  // of the topic.
+  std::vector<ChainResult> results(topics.size(), {true, 0, 0, 0, 0, 0, ""});
+  for (const auto & scan : scans) {
+    results[scan->topic] = scan->result;
+  }
+  for (size_t i = 0; i < segments.size(); ++i) {
+    auto & result = results[segments[i].topic];
+    const auto & segment_result = segment_results[i];
+    if (result.verified && !segment_result.verified) {
+      result.verified = false;
+      result.broken_index = result.messages + segment_result.broken_index;
+      result.broken_id = segment_result.broken_id;
+      result.broken_stamp = segment_result.broken_stamp;
+      result.error = segment_result.error;
+    }
+    result.messages += segment_result.messages;
+    result.bytes += segment_result.bytes;
+  }
+
+  size_t messages = 0;
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < topics.size(); ++i) {
+    const auto & result = results[i];
+    messages += result.messages;
+    bytes += result.bytes;
+    if (result.verified) {
+      std::printf("OK      %-40s %10zu messages\n", topics[i].topic.name.c_str(), result.messages);
+    } else if (!result.error.empty()) {
+      std::printf("ERROR   %-40s %s\n", topics[i].topic.name.c_str(), result.error.c_str());
+    } else {
+      std::printf("BROKEN  %-40s message %zu (id %lld, stamp %lld)\n",
+        topics[i].topic.name.c_str(), result.broken_index,
+        static_cast<long long>(result.broken_id), static_cast<long long>(result.broken_stamp));
+    }
+    verified = verified && result.verified;
+  }
+
+  std::printf("Verified %zu messages, %.1f MB in %.2f s (%.1f MB/s) on %zu threads.\n",
+    messages, bytes / (1024.0 * 1024.0), elapsed.count(),
+    bytes / (1024.0 * 1024.0) / std::max(elapsed.count(), 1e-9), threads);
+
+  return verified ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_blake3.hpp"
+
+using namespace ::testing;  // NOLINT
+using namespace rosbag2_storage_plugins;  // NOLINT
+
+namespace
+{
+
+// From the reference test_vectors.json: input byte i is i % 251, and the
+// expected values are the first 32 bytes of the extended output.
+const char KEY[] = "whats the Elvish word for friend";
+
+struct Blake3Vector
+{
+  size_t length;
+  std::string hash;
+  std::string keyed_hash;
+};
+
+std::vector<Blake3Vector> reference_vectors()
+{
+  return {
+    {
+      0,
+      "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262",
+      "92b2b75604ed3c761f9d6f62392c8a9227ad0ea3f09573e783f1498a4ed60d26"
+    },
+    {
+      1,
+      "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213",
+      "6d7878dfff2f485635d39013278ae14f1454b8c0a3a2d34bc1ab38228a80c95b"
+    },
+    {
+      1023,
+      "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11",
+      ""
+    },
+    {
+      1024,
+      "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7",
+      "75c46f6f3d9eb4f55ecaaee480db732e6c2105546f1e675003687c31719c7ba4"
+    },
+    {
+      1025,
+      "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444",
+      ""
+    },
+    {
+      2048,
+      "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a",
+      ""
+    },
+    {
+      8192,
+      "aae792484c8efe4f19e2ca7d371d8c467ffb10748d8a5a1ae579948f718a2a63",
+      ""
+    },
+    {
+      102400,
+      "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085",
+      ""
+    },
+  };
+}
+
+std::vector<unsigned char> make_input(size_t length)
+{
+  std::vector<unsigned char> input(length);
+  for (size_t i = 0; i < length; ++i) {
+    input[i] = static_cast<unsigned char>(i % 251);
+  }
+  return input;
+}
+
+std::string to_hex(const unsigned char * data, size_t length)
+{
+  std::string hex;
+  char byte[3];
+  for (size_t i = 0; i < length; ++i) {
+    std::snprintf(byte, sizeof(byte), "%02x", data[i]);
+    hex += byte;
+  }
+  return hex;
+}
+
+// Feeds the input in pieces of at most step bytes.
+std::string hash(
+  BbrBlake3Hasher & hasher, const std::vector<unsigned char> & input, size_t step)
+{
+  for (size_t offset = 0; offset < input.size(); offset += step) {
+    hasher.update(input.data() + offset, std::min(step, input.size() - offset));
+  }
+  unsigned char out[BbrBlake3Hasher::OUT_SIZE];
+  hasher.finalize(out);
+  return to_hex(out, sizeof(out));
+}
+
+}  // namespace
+
+TEST(Blake3Test, hash_matches_reference_vectors) {
+  BbrBlake3Hasher hasher;
+  for (const auto & vector : reference_vectors()) {
+    auto input = make_input(vector.length);
+    hasher.init();
+    EXPECT_EQ(vector.hash, hash(hasher, input, input.size() + 1)) <<
+      "length " << vector.length;
+  }
+}
+
+TEST(Blake3Test, keyed_hash_matches_reference_vectors) {
+  BbrBlake3Hasher hasher;
+  for (const auto & vector : reference_vectors()) {
+    if (vector.keyed_hash.empty()) {
+      continue;
+    }
+    auto input = make_input(vector.length);
+    hasher.init_keyed(reinterpret_cast<const unsigned char *>(KEY));
+    EXPECT_EQ(vector.keyed_hash, hash(hasher, input, input.size() + 1)) <<
+      "length " << vector.length;
+  }
+}
+
+TEST(Blake3Test, result_does_not_depend_on_update_sizes) {
+  // Odd step sizes split blocks and chunks at every alignment, and large
+  // ones reach the eight chunk path.
+  BbrBlake3Hasher hasher;
+  for (const auto & vector : reference_vectors()) {
+    auto input = make_input(vector.length);
+    for (size_t step : {1, 63, 64, 65, 1000, 1024, 8 * 1024 + 1}) {
+      hasher.init();
+      EXPECT_EQ(vector.hash, hash(hasher, input, step)) <<
+        "length " << vector.length << ", step " << step;
+    }
+  }
+}
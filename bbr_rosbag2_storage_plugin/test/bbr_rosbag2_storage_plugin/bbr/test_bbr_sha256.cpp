@@ -0,0 +1,226 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bbr_rosbag2_storage_plugin/bbr/bbr_sha256.hpp"
+
+using namespace ::testing;  // NOLINT
+using namespace rosbag2_storage_plugins;  // NOLINT
+
+namespace
+{
+
+struct HmacVector
+{
+  std::string key;
+  std::string data;
+  std::string digest;
+};
+
+// RFC 4231 test cases 1 to 7; case 5 is truncated to 128 bits in the RFC
+// and is listed here with its full digest.
+std::vector<HmacVector> rfc4231_vectors()
+{
+  return {
+    {
+      std::string(20, '\x0b'),
+      "Hi There",
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"
+    },
+    {
+      "Jefe",
+      "what do ya want for nothing?",
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"
+    },
+    {
+      std::string(20, '\xaa'),
+      std::string(50, '\xdd'),
+      "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe"
+    },
+    {
+      "\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10\x11\x12\x13\x14\x15"
+      "\x16\x17\x18\x19",
+      std::string(50, '\xcd'),
+      "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b"
+    },
+    {
+      std::string(20, '\x0c'),
+      "Test With Truncation",
+      "a3b6167473100ee06e0c796c2955552bfa6f7c0a6a8aef8b93f860aab0cd20c5"
+    },
+    {
+      std::string(131, '\xaa'),
+      "Test Using Larger Than Block-Size Key - Hash Key First",
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"
+    },
+    {
+      std::string(131, '\xaa'),
+      "This is a test using a larger than block-size key and a larger than block-size data. "
+      "The key needs to be hashed before being used by the HMAC algorithm.",
+      "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2"
+    },
+  };
+}
+
+std::string to_hex(const unsigned char * data, size_t length)
+{
+  std::string hex;
+  char byte[3];
+  for (size_t i = 0; i < length; ++i) {
+    std::snprintf(byte, sizeof(byte), "%02x", data[i]);
+    hex += byte;
+  }
+  return hex;
+}
+
+std::vector<Sha256Backend> supported_backends()
+{
+  std::vector<Sha256Backend> backends;
+  for (auto backend : {Sha256Backend::SCALAR, Sha256Backend::SHA_NI, Sha256Backend::AVX2}) {
+    if (isSha256BackendSupported(backend)) {
+      backends.push_back(backend);
+    }
+  }
+  return backends;
+}
+
+// FIPS 180-2 examples.
+std::vector<std::pair<std::string, std::string>> sha256_vectors()
+{
+  return {
+    {
+      "",
+      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+    },
+    {
+      "abc",
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+    },
+    {
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+    },
+    {
+      std::string(1000000, 'a'),
+      "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"
+    },
+  };
+}
+
+HmacSha256Job make_job(
+  const HmacVector & vector, size_t header_size, unsigned char * digest)
+{
+  return {
+    reinterpret_cast<const unsigned char *>(vector.key.data()), vector.key.size(),
+    vector.data.data(), header_size,
+    vector.data.data() + header_size, vector.data.size() - header_size,
+    digest};
+}
+
+}  // namespace
+
+TEST(Sha256Test, scalar_backend_is_always_supported) {
+  EXPECT_TRUE(isSha256BackendSupported(Sha256Backend::SCALAR));
+  EXPECT_TRUE(isSha256BackendSupported(detectSha256Backend()));
+}
+
+TEST(Sha256Test, every_backend_matches_rfc4231) {
+  for (auto backend : supported_backends()) {
+    for (const auto & vector : rfc4231_vectors()) {
+      unsigned char digest[SHA256_DIGEST_SIZE];
+      auto job = make_job(vector, 0, digest);
+      computeHmacSha256(&job, 1, backend);
+      EXPECT_EQ(vector.digest, to_hex(digest, sizeof(digest))) <<
+        getSha256BackendName(backend) << ": " << vector.data;
+    }
+  }
+}
+
+TEST(Sha256Test, header_and_data_are_hashed_as_one_message) {
+  for (auto backend : supported_backends()) {
+    for (const auto & vector : rfc4231_vectors()) {
+      for (size_t header_size = 1; header_size <= vector.data.size(); ++header_size) {
+        unsigned char digest[SHA256_DIGEST_SIZE];
+        auto job = make_job(vector, header_size, digest);
+        computeHmacSha256(&job, 1, backend);
+        ASSERT_EQ(vector.digest, to_hex(digest, sizeof(digest))) <<
+          getSha256BackendName(backend) << ": header of " << header_size << " bytes";
+      }
+    }
+  }
+}
+
+TEST(Sha256Test, batched_jobs_match_rfc4231) {
+  // More jobs than AVX2 lanes, so full and partial groups are both hashed.
+  auto vectors = rfc4231_vectors();
+  std::vector<HmacVector> batch;
+  for (size_t i = 0; i < 19; ++i) {
+    batch.push_back(vectors[i % vectors.size()]);
+  }
+
+  for (auto backend : supported_backends()) {
+    std::vector<unsigned char> digests(batch.size() * SHA256_DIGEST_SIZE);
+    std::vector<HmacSha256Job> jobs;
+    for (size_t i = 0; i < batch.size(); ++i) {
+      jobs.push_back(make_job(batch[i], i % 3, &digests[i * SHA256_DIGEST_SIZE]));
+    }
+    computeHmacSha256(jobs.data(), jobs.size(), backend);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      EXPECT_EQ(batch[i].digest, to_hex(&digests[i * SHA256_DIGEST_SIZE], SHA256_DIGEST_SIZE)) <<
+        getSha256BackendName(backend) << ": job " << i;
+    }
+  }
+}
+
+TEST(Sha256Test, hasher_matches_fips_180_2) {
+  for (auto backend : supported_backends()) {
+    BbrSha256Hasher hasher(backend);
+    for (const auto & vector : sha256_vectors()) {
+      // Hashing twice also checks that init() fully resets the hasher.
+      for (int pass = 0; pass < 2; ++pass) {
+        hasher.init();
+        hasher.update(vector.first.data(), vector.first.size());
+        unsigned char digest[SHA256_DIGEST_SIZE];
+        hasher.finalize(digest);
+        EXPECT_EQ(vector.second, to_hex(digest, sizeof(digest))) <<
+          getSha256BackendName(backend) << ": " << vector.first.size() << " bytes";
+      }
+    }
+  }
+}
+
+TEST(Sha256Test, hasher_does_not_depend_on_update_sizes) {
+  auto vector = sha256_vectors()[2];
+  for (auto backend : supported_backends()) {
+    BbrSha256Hasher hasher(backend);
+    for (size_t step = 1; step <= vector.first.size(); ++step) {
+      hasher.init();
+      for (size_t offset = 0; offset < vector.first.size(); offset += step) {
+        hasher.update(
+          vector.first.data() + offset, std::min(step, vector.first.size() - offset));
+      }
+      unsigned char digest[SHA256_DIGEST_SIZE];
+      hasher.finalize(digest);
+      ASSERT_EQ(vector.second, to_hex(digest, sizeof(digest))) <<
+        getSha256BackendName(backend) << ": step " << step;
+    }
+  }
+}
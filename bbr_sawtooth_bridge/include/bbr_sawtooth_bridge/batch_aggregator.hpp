@@ -0,0 +1,83 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BBR_SAWTOOTH_BRIDGE__BBR__BATCH_AGGREGATOR_HPP_
+#define BBR_SAWTOOTH_BRIDGE__BBR__BATCH_AGGREGATOR_HPP_
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "bbr_protobuf/proto/sawtooth/batch.pb.h"
+#include "bbr_protobuf/proto/sawtooth/client_batch_submit.pb.h"
+#include "bbr_protobuf/proto/sawtooth/transaction.pb.h"
+
+#include "bbr_sawtooth_bridge/bridge_signer.hpp"
+
+#include "rclcpp/logger.hpp"
+
+namespace bbr_sawtooth_bridge
+{
+
+// Packs signed transactions into batches of up to max_transactions, and
+// batches into submit requests of up to max_batches, so one batch signature
+// and one validator round trip cover many transactions. A request is handed
+// on once it is full, once its oldest transaction is deadline old, or when
+// the aggregator is destroyed.
+// Not thread safe; the bridge serializes calls to it.
+class BatchAggregator
+{
+public:
+  using FlushCallback = std::function<void (ClientBatchSubmitRequest)>;
+
+  BatchAggregator(
+    std::shared_ptr<Signer> batcher,
+    size_t max_transactions,
+    size_t max_batches,
+    std::chrono::milliseconds deadline,
+    FlushCallback flush_callback,
+    rclcpp::Logger logger);
+  ~BatchAggregator();
+
+  void add(Transaction transaction);
+
+  // Hands on the pending request if its oldest transaction has expired.
+  void flush_expired(std::chrono::steady_clock::time_point now);
+
+  // Hands on whatever is pending, sealing a partial batch.
+  void flush();
+
+  size_t pending_transactions() const;
+
+private:
+  void seal_batch();
+
+  std::shared_ptr<Signer> batcher_;
+  size_t max_transactions_;
+  size_t max_batches_;
+  std::chrono::milliseconds deadline_;
+  FlushCallback flush_callback_;
+  rclcpp::Logger logger_;
+
+  // Transactions of the batch being filled, and the sealed batches of the
+  // request being filled.
+  Batch open_batch_;
+  ClientBatchSubmitRequest request_;
+  size_t transaction_count_;
+  std::chrono::steady_clock::time_point started_;
+};
+
+}  // namespace bbr_sawtooth_bridge
+
+#endif  // BBR_SAWTOOTH_BRIDGE__BBR__BATCH_AGGREGATOR_HPP_
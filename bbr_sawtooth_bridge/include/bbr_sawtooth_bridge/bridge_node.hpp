@@ -15,8 +15,9 @@
 #ifndef BBR_SAWTOOTH_BRIDGE__BBR__NODE_HPP_
 #define BBR_SAWTOOTH_BRIDGE__BBR__NODE_HPP_
 
-#include <zmqpp/context.hpp>
-#include <zmqpp/socket.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
 
 #include "bbr_msgs/msg/checkpoint.hpp"
 #include "bbr_msgs/msg/checkpoint_array.hpp"
@@ -24,10 +25,15 @@
 #include "bbr_msgs/msg/record_array.hpp"
 #include "bbr_msgs/srv/create_records.hpp"
 
+#include "bbr_sawtooth_bridge/batch_aggregator.hpp"
 #include "bbr_sawtooth_bridge/bridge_signer.hpp"
+#include "bbr_sawtooth_bridge/signing_pool.hpp"
+#include "bbr_sawtooth_bridge/validator_client.hpp"
 
 #include "rclcpp/rclcpp.hpp"
 
+#include "Poco/Crypto/DigestEngine.h"
+
 // #include "std_msgs/msg/string.hpp"
 // #include "rosbag2_storage/serialized_bag_message.hpp"
 // #include "rosbag2_storage/topic_metadata.hpp"
@@ -54,6 +60,11 @@ private:
     const std::shared_ptr<bbr_msgs::srv::CreateRecords::Request> request,
     const std::shared_ptr<bbr_msgs::srv::CreateRecords::Response> response);
 
+  void transaction_signed(SigningPool::Result result);
+  void flush_expired_batches();
+  void submit_batches(ClientBatchSubmitRequest request);
+  void submit_callback(const ValidatorClient::Result & result);
+
   std::string path_to_key(std::string key_path);
 
   rclcpp::Subscription<bbr_msgs::msg::CheckpointArray>::SharedPtr checkpoints_subscription_;
@@ -64,8 +75,13 @@ private:
 
   std::shared_ptr<Poco::Crypto::DigestEngine> deigest_engine_;
 
-  zmqpp::context context_;
-  zmqpp::socket socket_;
+  std::unique_ptr<ValidatorClient> validator_client_;
+  // Fed by the signing pool and flushed by the timer, so guarded.
+  std::unique_ptr<BatchAggregator> aggregator_;
+  std::mutex aggregator_mutex_;
+  rclcpp::TimerBase::SharedPtr batch_timer_;
+  // Declared last so it drains before the aggregator goes away.
+  std::unique_ptr<SigningPool> signing_pool_;
 };
 
 }  // namespace bbr_sawtooth_bridge
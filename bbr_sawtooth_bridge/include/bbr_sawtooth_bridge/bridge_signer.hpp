@@ -17,28 +17,48 @@
 
 #include <secp256k1.h>
 
-#include "Poco/Crypto/DigestEngine.h"
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "bbr_sawtooth_bridge/hex_codec.hpp"
 
 namespace bbr_sawtooth_bridge
 {
 
-std::string encodeToHex(const std::string & str);
-std::string decodeFromHex(const std::string & str);
+// Creates a signing context of its own, for a thread that should not share
+// the process wide one. Like that one, it is randomized once on creation.
+std::shared_ptr<secp256k1_context> createSigningContext();
+
+// Compact secp256k1 ECDSA signature.
+using Signature = std::array<unsigned char, 64>;
 
 class Signer
 {
 public:
   Signer(const std::string & privkey_str);
+  // Signs with the given context, which the signer keeps alive.
+  Signer(const std::string & privkey_str, std::shared_ptr<secp256k1_context> context);
+
+  std::string sign(const std::string & message) const;
+  std::string _sign(const std::vector<unsigned char> & digest) const;
 
-  std::string sign(const std::string & message);
-  std::string _sign(const std::vector<unsigned char> & digest);
+  // Signs the SHA-256 of length bytes at message without allocating.
+  // Signing only reads the context, so this is safe to call concurrently.
+  void sign(const void * message, size_t length, Signature & signature) const;
+  void sign_digest(const unsigned char * digest32, Signature & signature) const;
 
   std::string privkey;
   std::string pubkey;
   std::string pubkey_str;
 
   secp256k1_context const * context_;
+
+private:
+  void init(const std::string & privkey_str);
+
+  std::shared_ptr<secp256k1_context> owned_context_;
 };
 
 }  // namespace bbr_sawtooth_bridge
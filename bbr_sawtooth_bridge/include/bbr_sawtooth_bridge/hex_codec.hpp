@@ -0,0 +1,41 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BBR_SAWTOOTH_BRIDGE__BBR__HEX_CODEC_HPP_
+#define BBR_SAWTOOTH_BRIDGE__BBR__HEX_CODEC_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace bbr_sawtooth_bridge
+{
+
+// Writes the lowercase hex of length bytes to out, which must have room for
+// 2 * length characters. No terminator is written.
+void encodeHex(const void * data, size_t length, char * out);
+
+// Decodes hex_length digits of either case into hex_length / 2 bytes at out.
+// Returns false if hex_length is odd or a character is not a hex digit, in
+// which case out holds unspecified bytes.
+bool decodeHex(const char * hex, size_t hex_length, void * out);
+
+std::string encodeToHex(const void * data, size_t length);
+std::string encodeToHex(const std::string & str);
+// Whitespace is skipped, so line wrapped hex and key files with trailing
+// newlines decode. Throws std::invalid_argument on anything else.
+std::string decodeFromHex(const std::string & str);
+
+}  // namespace bbr_sawtooth_bridge
+
+#endif  // BBR_SAWTOOTH_BRIDGE__BBR__HEX_CODEC_HPP_
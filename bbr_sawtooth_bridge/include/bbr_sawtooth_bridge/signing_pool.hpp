@@ -0,0 +1,98 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BBR_SAWTOOTH_BRIDGE__BBR__SIGNING_POOL_HPP_
+#define BBR_SAWTOOTH_BRIDGE__BBR__SIGNING_POOL_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bbr_protobuf/proto/sawtooth/transaction.pb.h"
+
+#include "bbr_sawtooth_bridge/bridge_signer.hpp"
+
+#include "rclcpp/logger.hpp"
+
+namespace bbr_sawtooth_bridge
+{
+
+// Signs transaction headers on a pool of worker threads, each with its own
+// secp256k1 context. Results are handed to the callback in the order they
+// were submitted, one at a time, by whichever worker completes the next one
+// in line. Callbacks run outside the pool's locks, so the other workers keep
+// signing meanwhile.
+class SigningPool
+{
+public:
+  struct Result
+  {
+    Transaction transaction;
+    // Why signing failed, empty otherwise.
+    std::string error;
+  };
+
+  using Callback = std::function<void (Result)>;
+
+  // Zero threads means one per hardware thread.
+  SigningPool(
+    const std::string & privkey, size_t threads, Callback callback, rclcpp::Logger logger);
+  // Signs and delivers everything already submitted before returning.
+  ~SigningPool();
+
+  void submit(std::string header, std::string payload);
+
+  size_t size() const;
+
+private:
+  struct Job
+  {
+    uint64_t sequence;
+    std::string header;
+    std::string payload;
+  };
+
+  void run(Signer & signer);
+  void deliver(uint64_t sequence, Result result);
+
+  Callback callback_;
+  rclcpp::Logger logger_;
+  std::vector<std::unique_ptr<Signer>> signers_;
+
+  std::deque<Job> jobs_;
+  uint64_t submitted_;
+  bool stopping_;
+  std::mutex jobs_mutex_;
+  std::condition_variable jobs_ready_;
+
+  // Results wait here until every earlier one is delivered. Only the worker
+  // that set delivering_ invokes the callback.
+  std::map<uint64_t, Result> completed_;
+  uint64_t delivered_;
+  bool delivering_;
+  std::mutex delivery_mutex_;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace bbr_sawtooth_bridge
+
+#endif  // BBR_SAWTOOTH_BRIDGE__BBR__SIGNING_POOL_HPP_
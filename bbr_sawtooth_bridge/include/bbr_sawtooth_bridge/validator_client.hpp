@@ -0,0 +1,122 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BBR_SAWTOOTH_BRIDGE__BBR__VALIDATOR_CLIENT_HPP_
+#define BBR_SAWTOOTH_BRIDGE__BBR__VALIDATOR_CLIENT_HPP_
+
+#include <zmqpp/context.hpp>
+#include <zmqpp/socket.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "bbr_protobuf/proto/sawtooth/client_batch_submit.pb.h"
+
+#include "rclcpp/logger.hpp"
+
+namespace bbr_sawtooth_bridge
+{
+
+// Submits batches to a Sawtooth validator without waiting for replies. Each
+// request is wrapped in a validator Message with its own correlation id, up
+// to max_in_flight requests are outstanding on the DEALER socket at once,
+// and responses are matched back by id. The socket is owned by an I/O
+// thread, so submit never blocks on the network.
+class ValidatorClient
+{
+public:
+  struct Result
+  {
+    std::string correlation_id;
+    // Status reported by the validator, STATUS_UNSET if none arrived.
+    ClientBatchSubmitResponse::Status status;
+    // Why no response arrived, empty otherwise.
+    std::string error;
+  };
+
+  // Invoked on the I/O thread, so it must be quick and must not block.
+  using Callback = std::function<void (const Result &)>;
+
+  ValidatorClient(
+    const std::string & url,
+    size_t max_in_flight,
+    size_t max_queued,
+    std::chrono::milliseconds timeout,
+    rclcpp::Logger logger);
+
+  // Stops accepting requests, then keeps sending the queue and waiting for
+  // responses until both are done or one request timeout has passed.
+  // Callbacks for anything still open are invoked with an error before the
+  // socket is closed.
+  ~ValidatorClient();
+
+  // Queues the request for the I/O thread and returns immediately. Returns
+  // false, without invoking the callback, if max_queued requests are
+  // already waiting to be sent.
+  bool submit(ClientBatchSubmitRequest request, Callback callback);
+
+private:
+  struct QueuedRequest
+  {
+    std::string correlation_id;
+    ClientBatchSubmitRequest request;
+    Callback callback;
+  };
+
+  struct PendingRequest
+  {
+    Callback callback;
+    std::chrono::steady_clock::time_point sent;
+  };
+
+  void run();
+  void send_queued();
+  void receive_messages();
+  void expire_requests(std::chrono::steady_clock::time_point now);
+  void complete(
+    const std::string & correlation_id, const Callback & callback,
+    ClientBatchSubmitResponse::Status status, const std::string & error);
+
+  rclcpp::Logger logger_;
+  size_t max_in_flight_;
+  size_t max_queued_;
+  std::chrono::milliseconds timeout_;
+
+  zmqpp::context context_;
+  zmqpp::socket socket_;
+  // Paired inproc sockets that wake the I/O thread when work is queued.
+  zmqpp::socket wake_sender_;
+  zmqpp::socket wake_receiver_;
+
+  // Guarded by mutex_: requests not yet handed to the socket.
+  std::mutex mutex_;
+  std::deque<QueuedRequest> queue_;
+  std::string correlation_prefix_;
+  uint64_t correlation_count_;
+  bool stopping_;
+
+  // Only touched by the I/O thread.
+  std::unordered_map<std::string, PendingRequest> pending_;
+  std::thread io_thread_;
+};
+
+}  // namespace bbr_sawtooth_bridge
+
+#endif  // BBR_SAWTOOTH_BRIDGE__BBR__VALIDATOR_CLIENT_HPP_
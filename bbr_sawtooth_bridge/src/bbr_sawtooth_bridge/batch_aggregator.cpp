@@ -0,0 +1,123 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbr_sawtooth_bridge/batch_aggregator.hpp"
+
+#include <exception>
+#include <string>
+#include <utility>
+
+#include "rclcpp/logging.hpp"
+
+namespace bbr_sawtooth_bridge
+{
+
+BatchAggregator::BatchAggregator(
+  std::shared_ptr<Signer> batcher,
+  size_t max_transactions,
+  size_t max_batches,
+  std::chrono::milliseconds deadline,
+  FlushCallback flush_callback,
+  rclcpp::Logger logger)
+: batcher_(batcher),
+  max_transactions_(max_transactions > 0 ? max_transactions : 1),
+  max_batches_(max_batches > 0 ? max_batches : 1),
+  deadline_(deadline),
+  flush_callback_(std::move(flush_callback)),
+  logger_(logger),
+  transaction_count_(0)
+{}
+
+BatchAggregator::~BatchAggregator()
+{
+  // Pending transactions are sealed and handed on rather than dropped.
+  size_t pending = transaction_count_;
+  try {
+    flush();
+    if (pending > 0) {
+      RCLCPP_INFO(logger_, "Submitted %zu pending transactions on shutdown", pending);
+    }
+  } catch (const std::exception & e) {
+    RCLCPP_ERROR(logger_, "Dropped %zu pending transactions on shutdown: %s",
+      pending, e.what());
+  }
+}
+
+void BatchAggregator::add(Transaction transaction)
+{
+  if (transaction_count_ == 0) {
+    started_ = std::chrono::steady_clock::now();
+  }
+  *open_batch_.add_transactions() = std::move(transaction);
+  ++transaction_count_;
+
+  if (static_cast<size_t>(open_batch_.transactions_size()) >= max_transactions_) {
+    seal_batch();
+    if (static_cast<size_t>(request_.batches_size()) >= max_batches_) {
+      flush();
+    }
+  }
+}
+
+void BatchAggregator::flush_expired(std::chrono::steady_clock::time_point now)
+{
+  if (transaction_count_ > 0 && now - started_ >= deadline_) {
+    flush();
+  }
+}
+
+void BatchAggregator::flush()
+{
+  seal_batch();
+  if (request_.batches_size() == 0) {
+    return;
+  }
+
+  ClientBatchSubmitRequest request;
+  request.Swap(&request_);
+  transaction_count_ = 0;
+  flush_callback_(std::move(request));
+}
+
+size_t BatchAggregator::pending_transactions() const
+{
+  return transaction_count_;
+}
+
+void BatchAggregator::seal_batch()
+{
+  if (open_batch_.transactions_size() == 0) {
+    return;
+  }
+
+  // The batch header commits to the transactions in order by their ids,
+  // which are their header signatures.
+  BatchHeader batch_header;
+  batch_header.set_signer_public_key(batcher_->pubkey_str);
+  for (const auto & transaction : open_batch_.transactions()) {
+    batch_header.add_transaction_ids(transaction.header_signature());
+  }
+
+  std::string batch_header_bytes;
+  batch_header.SerializeToString(&batch_header_bytes);
+  Signature signature;
+  batcher_->sign(batch_header_bytes.data(), batch_header_bytes.size(), signature);
+  open_batch_.set_header_signature(encodeToHex(signature.data(), signature.size()));
+  open_batch_.set_header(std::move(batch_header_bytes));
+
+  request_.add_batches()->Swap(&open_batch_);
+  open_batch_.Clear();
+}
+
+}  // namespace bbr_sawtooth_bridge
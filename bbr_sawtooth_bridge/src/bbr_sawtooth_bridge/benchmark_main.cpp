@@ -0,0 +1,196 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bbr_sawtooth_bridge/bridge_signer.hpp"
+#include "bbr_sawtooth_bridge/hex_codec.hpp"
+#include "bbr_sawtooth_bridge/signing_pool.hpp"
+
+#include "rclcpp/logger.hpp"
+
+#include "Poco/HexBinaryDecoder.h"
+#include "Poco/HexBinaryEncoder.h"
+#include "Poco/StreamCopier.h"
+
+namespace bbr = bbr_sawtooth_bridge;
+
+namespace
+{
+
+const char KEY_PRIV_HEX[] = "2f1e7b7a130d7ba9da0068b3bb0ba1d79e7e77110302c9f746c3c2a63fe40088";
+
+// Runs fn once and returns the rate of count operations per second.
+double measure(size_t count, const std::function<void()> & fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return count / elapsed.count();
+}
+
+void report(const std::string & name, double rate)
+{
+  std::printf("%-32s %12.0f ops/s\n", name.c_str(), rate);
+}
+
+// Transaction headers of roughly the size the bridge signs.
+std::vector<std::string> make_headers(size_t count)
+{
+  std::vector<std::string> headers(count);
+  for (size_t i = 0; i < count; ++i) {
+    headers[i] = std::string(300, 'h') + std::to_string(i);
+  }
+  return headers;
+}
+
+void benchmark_signer(const std::string & privkey, size_t count)
+{
+  auto headers = make_headers(count);
+  bbr::Signer signer(privkey);
+  double rate = measure(count, [&]() {
+        for (const auto & header : headers) {
+          bbr::encodeToHex(signer.sign(header));
+        }
+      });
+  report("Signer::sign inline", rate);
+}
+
+void benchmark_signing_pool(const std::string & privkey, size_t threads, size_t count)
+{
+  auto headers = make_headers(count);
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t signed_count = 0;
+
+  bbr::SigningPool pool(privkey, threads, [&](bbr::SigningPool::Result) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (++signed_count == count) {
+        done.notify_one();
+      }
+    }, rclcpp::get_logger("benchmark_cpp"));
+  double rate = measure(count, [&]() {
+        for (const auto & header : headers) {
+          pool.submit(header, "");
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() {return signed_count == count;});
+      });
+  report("SigningPool, " + std::to_string(pool.size()) + " threads", rate);
+}
+
+// The stream based encoding the bridge used before, without line breaks.
+std::string poco_encode(const std::string & data)
+{
+  std::istringstream source(data);
+  std::ostringstream sink;
+  Poco::HexBinaryEncoder encoder(sink);
+  encoder.rdbuf()->setLineLength(0);
+  Poco::StreamCopier::copyStream(source, encoder);
+  encoder.close();
+  return sink.str();
+}
+
+std::string poco_decode(const std::string & hex)
+{
+  std::istringstream source(hex);
+  std::ostringstream sink;
+  Poco::HexBinaryDecoder decoder(source);
+  Poco::StreamCopier::copyStream(decoder, sink);
+  return sink.str();
+}
+
+// Checks the hex codec against Poco for lengths on both sides of every
+// 16 byte SIMD stride boundary up to a few hundred bytes.
+bool check_hex()
+{
+  for (size_t length = 0; length < 300; ++length) {
+    std::string data(length, '\0');
+    for (size_t i = 0; i < length; ++i) {
+      data[i] = static_cast<char>(i * 131 + length);
+    }
+    std::string hex = bbr::encodeToHex(data);
+    if (hex != poco_encode(data) || bbr::decodeFromHex(hex) != data ||
+      poco_decode(hex) != data)
+    {
+      std::printf("Hex codec differs from Poco for %zu bytes\n", length);
+      return false;
+    }
+  }
+  return true;
+}
+
+void benchmark_hex(size_t size, size_t iterations)
+{
+  std::string data(size, '\xa5');
+  std::string hex = bbr::encodeToHex(data);
+  std::vector<char> buffer(2 * size);
+  std::string suffix = ", " + std::to_string(size) + " B";
+
+  double rate = measure(iterations, [&]() {
+        for (size_t i = 0; i < iterations; ++i) {
+          poco_encode(data);
+        }
+      });
+  report("Poco encode" + suffix, rate);
+  rate = measure(iterations, [&]() {
+        for (size_t i = 0; i < iterations; ++i) {
+          bbr::encodeHex(data.data(), data.size(), buffer.data());
+        }
+      });
+  report("encodeHex" + suffix, rate);
+  rate = measure(iterations, [&]() {
+        for (size_t i = 0; i < iterations; ++i) {
+          poco_decode(hex);
+        }
+      });
+  report("Poco decode" + suffix, rate);
+  rate = measure(iterations, [&]() {
+        for (size_t i = 0; i < iterations; ++i) {
+          bbr::decodeHex(hex.data(), hex.size(), buffer.data());
+        }
+      });
+  report("decodeHex" + suffix, rate);
+}
+
+}  // namespace
+
+int main()
+{
+  if (!check_hex()) {
+    return 1;
+  }
+  benchmark_hex(32, 200000);
+  benchmark_hex(64, 200000);
+  benchmark_hex(4096, 5000);
+
+  std::string privkey = bbr::decodeFromHex(KEY_PRIV_HEX);
+
+  benchmark_signer(privkey, 5000);
+  size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t threads = 1; threads < hardware_threads; threads *= 2) {
+    benchmark_signing_pool(privkey, threads, 20000);
+  }
+  benchmark_signing_pool(privkey, hardware_threads, 20000);
+  return 0;
+}
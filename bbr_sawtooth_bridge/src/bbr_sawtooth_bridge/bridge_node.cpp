@@ -13,9 +13,13 @@
 // limitations under the License.
 
 #include <inttypes.h>
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include <fcntl.h>
 #include <fstream>
+#include <utility>
 
 #include <zmq.h>
 
@@ -47,16 +51,35 @@ Bridge::Bridge(
   batcher_(),
   signer_(),
   deigest_engine_(),
-  context_(),
-  socket_(this->context_, zmqpp::socket_type::dealer)
+  validator_client_()
 {
 
   std::string zmq_url;
   this->declare_parameter("zmq_url");
   this->get_parameter("zmq_url", zmq_url);
+  // Submit requests awaiting a validator response at the same time.
+  this->declare_parameter("validator_max_in_flight", 64);
+  // Submit requests held while the in-flight window is full; beyond this
+  // checkpoints are dropped rather than stalling the executor.
+  this->declare_parameter("validator_max_queued", 4096);
+  // Time to wait for a submit response before reporting it as failed.
+  this->declare_parameter("validator_timeout_ms", 10000);
+  // Transactions packed into one batch under a single batcher signature.
+  this->declare_parameter("batch_max_transactions", 100);
+  // Batches sent in one submit request.
+  this->declare_parameter("batch_list_max_batches", 10);
+  // Age at which pending transactions are submitted in partial batches.
+  this->declare_parameter("batch_deadline_ms", 200);
+  // Threads signing transaction headers; 0 uses one per hardware thread.
+  this->declare_parameter("signing_threads", 0);
 
   try {
-    this->socket_.connect(zmq_url.c_str());
+    validator_client_ = std::make_unique<ValidatorClient>(
+      zmq_url,
+      static_cast<size_t>(this->get_parameter("validator_max_in_flight").as_int()),
+      static_cast<size_t>(this->get_parameter("validator_max_queued").as_int()),
+      std::chrono::milliseconds(this->get_parameter("validator_timeout_ms").as_int()),
+      this->get_logger());
     RCLCPP_INFO(
       this->get_logger(),
       "Connection to validator succeeded");
@@ -70,6 +93,28 @@ Bridge::Bridge(
   batcher_ = std::make_shared<Signer>(this->path_to_key(batcher_key_path));
   deigest_engine_ = std::make_shared<Poco::Crypto::DigestEngine>("SHA512");
 
+  auto batch_deadline = std::chrono::milliseconds(
+    this->get_parameter("batch_deadline_ms").as_int());
+  aggregator_ = std::make_unique<BatchAggregator>(
+    batcher_,
+    static_cast<size_t>(this->get_parameter("batch_max_transactions").as_int()),
+    static_cast<size_t>(this->get_parameter("batch_list_max_batches").as_int()),
+    batch_deadline,
+    std::bind(&Bridge::submit_batches, this, _1),
+    this->get_logger());
+  // Check at twice the deadline rate so no batch outlives it by much.
+  batch_timer_ = this->create_wall_timer(
+    std::max(batch_deadline / 2, std::chrono::milliseconds(1)),
+    std::bind(&Bridge::flush_expired_batches, this));
+  signing_pool_ = std::make_unique<SigningPool>(
+    signer_->privkey,
+    static_cast<size_t>(this->get_parameter("signing_threads").as_int()),
+    std::bind(&Bridge::transaction_signed, this, _1),
+    this->get_logger());
+  RCLCPP_INFO(
+    this->get_logger(),
+    "Signing transactions on %zu threads", signing_pool_->size());
+
   checkpoints_subscription_ = this->create_subscription<bbr_msgs::msg::CheckpointArray>(
     "checkpoints", 10, std::bind(&Bridge::checkpoints_callback, this, _1));
   create_records_server_ = this->create_service<bbr_msgs::srv::CreateRecords>(
@@ -82,13 +127,67 @@ void Bridge::create_records_callback(
   const std::shared_ptr<bbr_msgs::srv::CreateRecords::Response> response)
 {
   (void)request_header;
-  auto record = request->record_array.records[0];
   RCLCPP_INFO(
     this->get_logger(),
-    "request: %s", record.topic_name.c_str());
+    "request: %zu records", request->record_array.records.size());
+  for (const auto & record : request->record_array.records) {
+    RCLCPP_INFO(
+      this->get_logger(),
+      "record: %s", record.topic_name.c_str());
+  }
   response->success = true;
 }
 
+void Bridge::transaction_signed(SigningPool::Result result)
+{
+  if (!result.error.empty()) {
+    RCLCPP_ERROR(
+      this->get_logger(),
+      "Signing transaction failed, dropped it: %s", result.error.c_str());
+    return;
+  }
+  // Batched and batch-signed with other transactions before submission.
+  std::lock_guard<std::mutex> lock(aggregator_mutex_);
+  aggregator_->add(std::move(result.transaction));
+}
+
+void Bridge::flush_expired_batches()
+{
+  std::lock_guard<std::mutex> lock(aggregator_mutex_);
+  aggregator_->flush_expired(std::chrono::steady_clock::now());
+}
+
+void Bridge::submit_batches(ClientBatchSubmitRequest request)
+{
+  int batch_count = request.batches_size();
+  // Sent and answered on the client's I/O thread.
+  bool queued = validator_client_->submit(
+    std::move(request), std::bind(&Bridge::submit_callback, this, _1));
+  if (!queued) {
+    RCLCPP_ERROR(
+      this->get_logger(),
+      "Validator submit queue is full, dropped %d batches", batch_count);
+  }
+}
+
+void Bridge::submit_callback(const ValidatorClient::Result & result)
+{
+  if (!result.error.empty()) {
+    RCLCPP_ERROR(
+      this->get_logger(),
+      "Batch submission '%s' failed: %s", result.correlation_id.c_str(), result.error.c_str());
+  } else if (result.status != ClientBatchSubmitResponse::OK) {
+    RCLCPP_ERROR(
+      this->get_logger(),
+      "Batch submission '%s' rejected: %s", result.correlation_id.c_str(),
+      ClientBatchSubmitResponse::Status_Name(result.status).c_str());
+  } else {
+    RCLCPP_DEBUG(
+      this->get_logger(),
+      "Batch submission '%s' accepted", result.correlation_id.c_str());
+  }
+}
+
 std::string Bridge::path_to_key(
   std::string key_path)
 {
@@ -135,62 +234,22 @@ void Bridge::checkpoints_callback(
 
   txn_header.set_signer_public_key(signer_->pubkey_str);
   txn_header.set_batcher_public_key(batcher_->pubkey_str);
+  // Signing is deterministic, so without a nonce every header would hash
+  // to the same transaction id and a batch would list duplicates.
+  txn_header.set_nonce(Poco::UUIDGenerator::defaultGenerator().createRandom().toString());
 //  transaction.set_dependencies();
 
   deigest_engine_->reset();
   deigest_engine_->update(txn_payload);
   auto digest = deigest_engine_->digest();
-  txn_header.set_payload_sha512(
-    Poco::DigestEngine::digestToHex(digest));
-
+  txn_header.set_payload_sha512(encodeToHex(digest.data(), digest.size()));
 
-  BatchList batch_list;
-  auto batch = batch_list.add_batches();
-  auto transaction = batch->add_transactions();
 
   std::string txn_header_bytes;
   txn_header.SerializeToString(&txn_header_bytes);
-  auto txn_header_signature = encodeToHex(signer_->sign(txn_header_bytes));
-
-  transaction->set_header(txn_header_bytes);
-  transaction->set_header_signature(txn_header_signature);
-  transaction->set_payload(txn_payload);
-
-  BatchHeader batch_header;
-  batch_header.set_signer_public_key(batcher_->pubkey_str);
-  auto transaction_id = batch_header.add_transaction_ids();
-  transaction_id->assign(transaction->header_signature());
-
-  std::string batch_header_bytes;
-  batch_header.SerializeToString(&batch_header_bytes);
-  auto batch_header_signature = encodeToHex(batcher_->sign(batch_header_bytes));
-
-  batch->set_header(batch_header_bytes);
-  batch->set_header_signature(batch_header_signature);
-
-  std::string batch_list_bytes;
-  batch_list.SerializeToString(&batch_list_bytes);
-
-//  const std::string& correlation_id = encodeToHex(
-//      Poco::UUIDGenerator().createRandom().toString());
-//
-//  int fd = open ("/home/ruffsl/Desktop/sawtooth/batches.intkey", O_RDONLY);
-//  BatchList batch_list2;
-//  batch_list2.ParseFromFileDescriptor(fd);
-//
-//  std::string batch_list2_bytes;
-//  batch_list2.SerializeToString(&batch_list2_bytes);
-//
-//  Message message;
-//  message.set_message_type(Message::CLIENT_BATCH_SUBMIT_REQUEST);
-//  message.set_correlation_id(correlation_id);
-//  message.set_content(batch_list2_bytes);
-//
-//  std::string message_data;
-//  message.SerializeToString(&message_data);
-//
-//  this->socket_.send(message_data);
 
+  // Signed on the pool, which hands it on in order to transaction_signed.
+  signing_pool_->submit(std::move(txn_header_bytes), std::move(txn_payload));
 }
 
 }  // namespace bbr_sawtooth_bridge
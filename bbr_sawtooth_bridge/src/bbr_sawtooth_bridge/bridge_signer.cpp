@@ -13,23 +13,34 @@
 // limitations under the License.
 
 #include <assert.h>
-#include <iostream>
+#include <array>
 #include <inttypes.h>
 #include <memory>
-#include <sstream>
+#include <stdexcept>
+
+#include <openssl/rand.h>
+#include <openssl/sha.h>
 
 #include "bbr_sawtooth_bridge/bridge_signer.hpp"
 
-#include "Poco/DigestStream.h"
-#include "Poco/HexBinaryDecoder.h"
-#include "Poco/HexBinaryEncoder.h"
-#include "Poco/StreamCopier.h"
 
+// Seeds the blinding of the context's precomputed tables once, guarding
+// every later signature against timing and power side channels.
+secp256k1_context * createRandomizedContext(unsigned int flags)
+{
+  secp256k1_context * context = secp256k1_context_create(flags);
+  unsigned char seed[32];
+  if (RAND_bytes(seed, sizeof(seed)) != 1 || secp256k1_context_randomize(context, seed) != 1) {
+    secp256k1_context_destroy(context);
+    throw std::runtime_error("Failed to randomize secp256k1 context");
+  }
+  return context;
+}
 
 secp256k1_context const * getCtx()
 {
   static std::unique_ptr<secp256k1_context, decltype(&secp256k1_context_destroy)> s_ctx{
-    secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY),
+    createRandomizedContext(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY),
     &secp256k1_context_destroy
   };
   return s_ctx.get();
@@ -39,91 +50,77 @@ namespace bbr_sawtooth_bridge
 {
 
 
+std::shared_ptr<secp256k1_context> createSigningContext()
+{
+  return std::shared_ptr<secp256k1_context>(
+    createRandomizedContext(SECP256K1_CONTEXT_SIGN), &secp256k1_context_destroy);
+}
+
 Signer::Signer(const std::string & privkey_str)
 {
   context_ = getCtx();
+  init(privkey_str);
+}
+
+Signer::Signer(const std::string & privkey_str, std::shared_ptr<secp256k1_context> context)
+: owned_context_(context)
+{
+  context_ = owned_context_.get();
+  init(privkey_str);
+}
+
+void Signer::init(const std::string & privkey_str)
+{
   privkey = privkey_str;
 
   const unsigned char * privkey_ptr = (unsigned char *) privkey.c_str();
-  std::unique_ptr<secp256k1_pubkey> pubkey_ptr(new secp256k1_pubkey);
+  secp256k1_pubkey raw_pubkey;
   [[maybe_unused]] int pubkey_created = secp256k1_ec_pubkey_create(
-    context_, pubkey_ptr.get(), privkey_ptr);
+    context_, &raw_pubkey, privkey_ptr);
   assert(pubkey_created == 1);
 
 
   std::array<uint8_t, 33> pubkey_bytes;
   size_t serializedPubkeySize = pubkey_bytes.size();
   [[maybe_unused]] int pubkey_serialize = secp256k1_ec_pubkey_serialize(
-    context_, pubkey_bytes.data(), &serializedPubkeySize, pubkey_ptr.get(),
+    context_, pubkey_bytes.data(), &serializedPubkeySize, &raw_pubkey,
     SECP256K1_EC_COMPRESSED);
   assert(pubkey_serialize == 1);
-  pubkey = std::string((char *) pubkey_bytes.data());
+  // Sized explicitly; the serialized key is binary and not NUL terminated.
+  pubkey = std::string((char *) pubkey_bytes.data(), serializedPubkeySize);
   pubkey_str = encodeToHex(pubkey);
 }
 
 
-std::string Signer::sign(const std::string & message)
+std::string Signer::sign(const std::string & message) const
 {
-
-  std::istringstream source(message);
-  Poco::Crypto::DigestEngine sha256("SHA256");
-  sha256.reset();
-  Poco::DigestOutputStream digest_output_stream(sha256);
-  Poco::StreamCopier::copyStream(source, digest_output_stream);
-  digest_output_stream.close();
-  auto digest = sha256.digest();
-
-//  Poco::Crypto::DigestEngine sha256("SHA256");
-//  sha256.reset();
-//  sha256.update(message);
-//  auto digest = sha256.digest();
-
-  return this->_sign(digest);
-
+  Signature signature;
+  sign(message.data(), message.size(), signature);
+  return std::string(reinterpret_cast<const char *>(signature.data()), signature.size());
 }
 
-std::string Signer::_sign(const std::vector<unsigned char> & digest)
+std::string Signer::_sign(const std::vector<unsigned char> & digest) const
 {
-
-  std::unique_ptr<secp256k1_ecdsa_signature> raw_sig(new secp256k1_ecdsa_signature);
-  const unsigned char * msg32 = digest.data();
-  secp256k1_nonce_function nonce_fn = NULL;
-  const void * nonce_data = NULL;
-
-  const unsigned char * privkey_ptr = (unsigned char *) privkey.c_str();
-  secp256k1_ecdsa_sign(
-    context_, raw_sig.get(), msg32, privkey_ptr, nonce_fn, nonce_data);
-
-  std::array<uint8_t, 64> output64;
-  secp256k1_ecdsa_signature_serialize_compact(
-    context_, output64.data(), raw_sig.get());
-  std::string signature((char *)output64.data(), output64.size());
-
-  return signature;
-
+  Signature signature;
+  sign_digest(digest.data(), signature);
+  return std::string(reinterpret_cast<const char *>(signature.data()), signature.size());
 }
 
-std::string encodeToHex(const std::string & str)
+void Signer::sign(const void * message, size_t length, Signature & signature) const
 {
-  std::istringstream source(str);
-  std::ostringstream sink;
-
-  Poco::HexBinaryEncoder encoder(sink);
-  Poco::StreamCopier::copyStream(source, encoder);
-  encoder.close();
-
-  return sink.str();
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(static_cast<const unsigned char *>(message), length, digest);
+  sign_digest(digest, signature);
 }
 
-std::string decodeFromHex(const std::string & str)
+void Signer::sign_digest(const unsigned char * digest32, Signature & signature) const
 {
-  std::istringstream source(str);
-  std::ostringstream sink;
-
-  Poco::HexBinaryDecoder decoder(source);
-  Poco::StreamCopier::copyStream(decoder, sink);
-
-  return sink.str();
+  secp256k1_ecdsa_signature raw_sig;
+  const unsigned char * privkey_ptr = reinterpret_cast<const unsigned char *>(privkey.data());
+  if (secp256k1_ecdsa_sign(context_, &raw_sig, digest32, privkey_ptr, NULL, NULL) != 1) {
+    throw std::runtime_error("Failed to sign digest");
+  }
+  secp256k1_ecdsa_signature_serialize_compact(context_, signature.data(), &raw_sig);
 }
 
 }  // namespace bbr_sawtooth_bridge
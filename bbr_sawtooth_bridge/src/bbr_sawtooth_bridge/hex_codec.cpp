@@ -0,0 +1,166 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbr_sawtooth_bridge/hex_codec.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+# define BBR_HEX_SSE2 1
+# include <emmintrin.h>
+#endif
+
+namespace bbr_sawtooth_bridge
+{
+
+namespace
+{
+
+const char DIGITS[] = "0123456789abcdef";
+
+// Bit set in a decode table entry for characters that are not hex digits.
+const uint16_t INVALID = 0x100;
+
+struct HexTables
+{
+  HexTables()
+  {
+    for (size_t i = 0; i < 256; ++i) {
+      encode[2 * i] = DIGITS[i >> 4];
+      encode[2 * i + 1] = DIGITS[i & 0x0f];
+      decode[i] = INVALID;
+    }
+    for (uint16_t i = 0; i < 10; ++i) {
+      decode['0' + i] = i;
+    }
+    for (uint16_t i = 0; i < 6; ++i) {
+      decode['a' + i] = 10 + i;
+      decode['A' + i] = 10 + i;
+    }
+  }
+
+  // Both digits of every byte value, and the value of every character.
+  char encode[512];
+  uint16_t decode[256];
+};
+
+const HexTables & tables()
+{
+  static const HexTables hex_tables;
+  return hex_tables;
+}
+
+#ifdef BBR_HEX_SSE2
+
+// Converts sixteen nibbles to their lowercase digits.
+inline __m128i nibbles_to_hex(__m128i nibbles)
+{
+  const __m128i nine = _mm_set1_epi8(9);
+  const __m128i letter_offset = _mm_set1_epi8('a' - '0' - 10);
+  __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, nine), letter_offset);
+  return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+// Encodes 16 bytes per iteration and returns how many bytes it consumed.
+size_t encode_sse2(const unsigned char * data, size_t length, char * out)
+{
+  const __m128i low_mask = _mm_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_mask);
+    __m128i low = _mm_and_si128(bytes, low_mask);
+    __m128i first = nibbles_to_hex(_mm_unpacklo_epi8(high, low));
+    __m128i second = nibbles_to_hex(_mm_unpackhi_epi8(high, low));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), first);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i + 16), second);
+  }
+  return i;
+}
+
+#endif
+
+}  // namespace
+
+void encodeHex(const void * data, size_t length, char * out)
+{
+  auto bytes = static_cast<const unsigned char *>(data);
+  size_t i = 0;
+#ifdef BBR_HEX_SSE2
+  i = encode_sse2(bytes, length, out);
+#endif
+  const char * encode = tables().encode;
+  for (; i < length; ++i) {
+    std::memcpy(out + 2 * i, encode + 2 * bytes[i], 2);
+  }
+}
+
+bool decodeHex(const char * hex, size_t hex_length, void * out)
+{
+  if (hex_length % 2 != 0) {
+    return false;
+  }
+  auto digits = reinterpret_cast<const unsigned char *>(hex);
+  auto bytes = static_cast<unsigned char *>(out);
+  const uint16_t * decode = tables().decode;
+  uint16_t invalid = 0;
+  for (size_t i = 0; i < hex_length / 2; ++i) {
+    uint16_t high = decode[digits[2 * i]];
+    uint16_t low = decode[digits[2 * i + 1]];
+    invalid |= high | low;
+    bytes[i] = static_cast<unsigned char>((high << 4) | low);
+  }
+  return (invalid & INVALID) == 0;
+}
+
+std::string encodeToHex(const void * data, size_t length)
+{
+  std::string hex(2 * length, '\0');
+  if (length > 0) {
+    encodeHex(data, length, &hex[0]);
+  }
+  return hex;
+}
+
+std::string encodeToHex(const std::string & str)
+{
+  return encodeToHex(str.data(), str.size());
+}
+
+std::string decodeFromHex(const std::string & str)
+{
+  const char * hex = str.data();
+  size_t hex_length = str.size();
+  std::string compact;
+  if (str.find_first_of(" \t\r\n") != std::string::npos) {
+    compact.reserve(str.size());
+    for (char c : str) {
+      if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+        compact.push_back(c);
+      }
+    }
+    hex = compact.data();
+    hex_length = compact.size();
+  }
+
+  std::string bytes(hex_length / 2, '\0');
+  if (!decodeHex(hex, hex_length, &bytes[0])) {
+    throw std::invalid_argument("Invalid hex string");
+  }
+  return bytes;
+}
+
+}  // namespace bbr_sawtooth_bridge
@@ -0,0 +1,141 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbr_sawtooth_bridge/signing_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include "rclcpp/logging.hpp"
+
+namespace bbr_sawtooth_bridge
+{
+
+SigningPool::SigningPool(
+  const std::string & privkey, size_t threads, Callback callback, rclcpp::Logger logger)
+: callback_(std::move(callback)),
+  logger_(logger),
+  submitted_(0),
+  stopping_(false),
+  delivered_(0),
+  delivering_(false)
+{
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    signers_.push_back(std::make_unique<Signer>(privkey, createSigningContext()));
+  }
+  for (auto & signer : signers_) {
+    workers_.emplace_back(&SigningPool::run, this, std::ref(*signer));
+  }
+}
+
+SigningPool::~SigningPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    stopping_ = true;
+  }
+  jobs_ready_.notify_all();
+  for (auto & worker : workers_) {
+    worker.join();
+  }
+}
+
+void SigningPool::submit(std::string header, std::string payload)
+{
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    jobs_.push_back({submitted_++, std::move(header), std::move(payload)});
+  }
+  jobs_ready_.notify_one();
+}
+
+size_t SigningPool::size() const
+{
+  return workers_.size();
+}
+
+void SigningPool::run(Signer & signer)
+{
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex_);
+      jobs_ready_.wait(lock, [this]() {return stopping_ || !jobs_.empty();});
+      if (jobs_.empty()) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    // A failure is delivered in sequence like a signature, so later
+    // transactions are not held back behind it.
+    Result result;
+    try {
+      Signature signature;
+      signer.sign(job.header.data(), job.header.size(), signature);
+      result.transaction.set_header_signature(encodeToHex(signature.data(), signature.size()));
+      result.transaction.set_header(std::move(job.header));
+      result.transaction.set_payload(std::move(job.payload));
+    } catch (const std::exception & e) {
+      result.error = e.what();
+    }
+    deliver(job.sequence, std::move(result));
+  }
+}
+
+void SigningPool::deliver(uint64_t sequence, Result result)
+{
+  std::unique_lock<std::mutex> lock(delivery_mutex_);
+  completed_.emplace(sequence, std::move(result));
+  if (delivering_) {
+    // The delivering worker picks this up before it stops.
+    return;
+  }
+  delivering_ = true;
+
+  std::vector<Result> ready;
+  while (true) {
+    for (auto next = completed_.begin();
+      next != completed_.end() && next->first == delivered_;
+      next = completed_.begin())
+    {
+      ready.push_back(std::move(next->second));
+      completed_.erase(next);
+      ++delivered_;
+    }
+    if (ready.empty()) {
+      delivering_ = false;
+      return;
+    }
+
+    lock.unlock();
+    for (auto & next : ready) {
+      try {
+        callback_(std::move(next));
+      } catch (const std::exception & e) {
+        RCLCPP_ERROR(logger_, "Signing pool callback threw: %s", e.what());
+      }
+    }
+    ready.clear();
+    lock.lock();
+  }
+}
+
+}  // namespace bbr_sawtooth_bridge
@@ -0,0 +1,251 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bbr_sawtooth_bridge/validator_client.hpp"
+
+#include <zmqpp/poller.hpp>
+
+#include <exception>
+#include <utility>
+
+#include "bbr_protobuf/proto/sawtooth/validator.pb.h"
+
+#include "rclcpp/logging.hpp"
+
+#include "Poco/UUIDGenerator.h"
+
+namespace bbr_sawtooth_bridge
+{
+
+namespace
+{
+
+// Upper bound on how long the I/O thread sleeps, so expired requests are
+// noticed even while the validator is silent.
+const long POLL_TIMEOUT_MS = 100;
+
+}  // namespace
+
+ValidatorClient::ValidatorClient(
+  const std::string & url,
+  size_t max_in_flight,
+  size_t max_queued,
+  std::chrono::milliseconds timeout,
+  rclcpp::Logger logger)
+: logger_(logger),
+  max_in_flight_(max_in_flight > 0 ? max_in_flight : 1),
+  max_queued_(max_queued),
+  timeout_(timeout),
+  context_(),
+  socket_(context_, zmqpp::socket_type::dealer),
+  wake_sender_(context_, zmqpp::socket_type::pair),
+  wake_receiver_(context_, zmqpp::socket_type::pair),
+  correlation_prefix_(Poco::UUIDGenerator::defaultGenerator().createRandom().toString()),
+  correlation_count_(0),
+  stopping_(false)
+{
+  socket_.set(zmqpp::socket_option::linger, 0);
+  socket_.connect(url);
+
+  std::string wake_endpoint = "inproc://validator-client-" + correlation_prefix_;
+  wake_receiver_.bind(wake_endpoint);
+  wake_sender_.connect(wake_endpoint);
+
+  io_thread_ = std::thread(&ValidatorClient::run, this);
+}
+
+ValidatorClient::~ValidatorClient()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    wake_sender_.send(std::string(), true);
+  }
+  io_thread_.join();
+}
+
+bool ValidatorClient::submit(ClientBatchSubmitRequest request, Callback callback)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_ || queue_.size() >= max_queued_) {
+    return false;
+  }
+  std::string correlation_id = correlation_prefix_ + "-" + std::to_string(correlation_count_++);
+  queue_.push_back({std::move(correlation_id), std::move(request), std::move(callback)});
+  // A failed send means a wake-up is already pending.
+  wake_sender_.send(std::string(), true);
+  return true;
+}
+
+void ValidatorClient::run()
+{
+  zmqpp::poller poller;
+  poller.add(socket_, zmqpp::poller::poll_in);
+  poller.add(wake_receiver_, zmqpp::poller::poll_in);
+
+  // Once stopping, requests already queued are still sent and responses
+  // awaited, but for no longer than one request timeout in total.
+  bool draining = false;
+  std::chrono::steady_clock::time_point drain_deadline;
+  while (true) {
+    poller.poll(POLL_TIMEOUT_MS);
+    if (poller.has_input(wake_receiver_)) {
+      std::string wake;
+      while (wake_receiver_.receive(wake, true)) {
+      }
+    }
+    if (poller.has_input(socket_)) {
+      receive_messages();
+    }
+    send_queued();
+    auto now = std::chrono::steady_clock::now();
+    expire_requests(now);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      if (!draining) {
+        draining = true;
+        drain_deadline = now + timeout_;
+      }
+      if ((queue_.empty() && pending_.empty()) || now >= drain_deadline) {
+        break;
+      }
+    }
+  }
+
+  // Nothing more will be sent or received; report every open request.
+  for (const auto & pending : pending_) {
+    complete(pending.first, pending.second.callback, ClientBatchSubmitResponse::STATUS_UNSET,
+      "validator client stopped");
+  }
+  pending_.clear();
+  std::deque<QueuedRequest> queue;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue.swap(queue_);
+  }
+  for (const auto & queued : queue) {
+    complete(queued.correlation_id, queued.callback, ClientBatchSubmitResponse::STATUS_UNSET,
+      "validator client stopped");
+  }
+}
+
+void ValidatorClient::send_queued()
+{
+  while (pending_.size() < max_in_flight_) {
+    QueuedRequest queued;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (queue_.empty()) {
+        return;
+      }
+      queued = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    Message message;
+    message.set_message_type(Message::CLIENT_BATCH_SUBMIT_REQUEST);
+    message.set_correlation_id(queued.correlation_id);
+    queued.request.SerializeToString(message.mutable_content());
+    std::string message_bytes;
+    message.SerializeToString(&message_bytes);
+
+    if (!socket_.send(message_bytes, true)) {
+      // No validator connected yet or its queue is full; retry on the next
+      // wake-up or poll timeout, keeping submission order.
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_front(std::move(queued));
+      return;
+    }
+    pending_.emplace(
+      std::move(queued.correlation_id),
+      PendingRequest{std::move(queued.callback), std::chrono::steady_clock::now()});
+  }
+}
+
+void ValidatorClient::receive_messages()
+{
+  std::string message_bytes;
+  while (socket_.receive(message_bytes, true)) {
+    Message message;
+    if (!message.ParseFromString(message_bytes)) {
+      RCLCPP_WARN(logger_, "Dropped malformed message from validator");
+      continue;
+    }
+
+    switch (message.message_type()) {
+      case Message::CLIENT_BATCH_SUBMIT_RESPONSE: {
+          auto pending = pending_.find(message.correlation_id());
+          if (pending == pending_.end()) {
+            RCLCPP_DEBUG(logger_, "Response for unknown or expired request '%s'",
+              message.correlation_id().c_str());
+            break;
+          }
+          ClientBatchSubmitResponse response;
+          if (response.ParseFromString(message.content())) {
+            complete(pending->first, pending->second.callback, response.status(), "");
+          } else {
+            complete(pending->first, pending->second.callback,
+              ClientBatchSubmitResponse::STATUS_UNSET, "malformed response");
+          }
+          pending_.erase(pending);
+          break;
+        }
+      case Message::PING_REQUEST: {
+          // The validator drops connections that stop answering pings.
+          Message reply;
+          reply.set_message_type(Message::PING_RESPONSE);
+          reply.set_correlation_id(message.correlation_id());
+          std::string reply_bytes;
+          reply.SerializeToString(&reply_bytes);
+          socket_.send(reply_bytes, true);
+          break;
+        }
+      default:
+        RCLCPP_DEBUG(logger_, "Ignored validator message of type %d",
+          static_cast<int>(message.message_type()));
+        break;
+    }
+  }
+}
+
+void ValidatorClient::expire_requests(std::chrono::steady_clock::time_point now)
+{
+  for (auto pending = pending_.begin(); pending != pending_.end(); ) {
+    if (now - pending->second.sent < timeout_) {
+      ++pending;
+      continue;
+    }
+    complete(pending->first, pending->second.callback, ClientBatchSubmitResponse::STATUS_UNSET,
+      "no response from validator");
+    pending = pending_.erase(pending);
+  }
+}
+
+void ValidatorClient::complete(
+  const std::string & correlation_id, const Callback & callback,
+  ClientBatchSubmitResponse::Status status, const std::string & error)
+{
+  if (!callback) {
+    return;
+  }
+  try {
+    callback({correlation_id, status, error});
+  } catch (const std::exception & e) {
+    RCLCPP_ERROR(logger_, "Submit callback for '%s' threw: %s", correlation_id.c_str(),
+      e.what());
+  }
+}
+
+}  // namespace bbr_sawtooth_bridge
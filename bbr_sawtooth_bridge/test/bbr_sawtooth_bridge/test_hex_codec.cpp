@@ -0,0 +1,95 @@
+// Copyright 2019, Ruffin White.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "bbr_sawtooth_bridge/hex_codec.hpp"
+
+using namespace ::testing;  // NOLINT
+using namespace bbr_sawtooth_bridge;  // NOLINT
+
+namespace
+{
+
+// Byte by byte reference for the table and SIMD encoders.
+std::string reference_hex(const std::string & data)
+{
+  std::string hex;
+  char byte[3];
+  for (unsigned char c : data) {
+    std::snprintf(byte, sizeof(byte), "%02x", c);
+    hex += byte;
+  }
+  return hex;
+}
+
+// Covers every byte value and lengths on both sides of each 16 byte stride.
+std::string make_data(size_t length, size_t seed)
+{
+  std::string data(length, '\0');
+  for (size_t i = 0; i < length; ++i) {
+    data[i] = static_cast<char>((i * 167 + seed * 31) & 0xff);
+  }
+  return data;
+}
+
+}  // namespace
+
+TEST(HexCodecTest, encodes_known_values) {
+  EXPECT_EQ("", encodeToHex(std::string()));
+  EXPECT_EQ("00", encodeToHex(std::string(1, '\0')));
+  EXPECT_EQ("0123456789abcdef", encodeToHex(std::string("\x01\x23\x45\x67\x89\xab\xcd\xef")));
+  EXPECT_EQ("ff7f80", encodeToHex(std::string("\xff\x7f\x80")));
+}
+
+TEST(HexCodecTest, encode_matches_reference_and_round_trips) {
+  for (size_t length = 0; length < 300; ++length) {
+    for (size_t seed = 0; seed < 4; ++seed) {
+      auto data = make_data(length, seed);
+      auto hex = encodeToHex(data);
+      ASSERT_EQ(reference_hex(data), hex) << "length " << length;
+      ASSERT_EQ(hex, encodeToHex(data.data(), data.size())) << "length " << length;
+      ASSERT_EQ(data, decodeFromHex(hex)) << "length " << length;
+    }
+  }
+}
+
+TEST(HexCodecTest, decodes_upper_case) {
+  EXPECT_EQ(std::string("\xab\xcd\xef"), decodeFromHex("ABCDEF"));
+  EXPECT_EQ(std::string("\xab\xcd\xef"), decodeFromHex("aBcDeF"));
+}
+
+TEST(HexCodecTest, decode_skips_whitespace) {
+  EXPECT_EQ(std::string("\x01\x23\x45"), decodeFromHex("0123\n45\n"));
+  EXPECT_EQ(std::string("\x01\x23\x45"), decodeFromHex(" 01 23\t45\r\n"));
+}
+
+TEST(HexCodecTest, decode_rejects_invalid_input) {
+  EXPECT_THROW(decodeFromHex("abc"), std::invalid_argument);
+  EXPECT_THROW(decodeFromHex("0g"), std::invalid_argument);
+  EXPECT_THROW(decodeFromHex("zz"), std::invalid_argument);
+}
+
+TEST(HexCodecTest, raw_decode_reports_invalid_input) {
+  unsigned char out[2];
+  EXPECT_TRUE(decodeHex("beef", 4, out));
+  EXPECT_EQ(0xbe, out[0]);
+  EXPECT_EQ(0xef, out[1]);
+  EXPECT_FALSE(decodeHex("bee", 3, out));
+  EXPECT_FALSE(decodeHex("be:f", 4, out));
+}